@@ -0,0 +1,88 @@
+#ifndef AsyncSolver_h
+#define AsyncSolver_h
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include "Puzzle.h"
+#include "ThreadPool.h"
+
+// Solves in the background so a service can have many searches going at once without a
+// thread of its own for each one: every query is queued onto one pool, which runs as
+// many at a time as it has threads. Solve hands back a future at once.
+//
+// A search looks up from its work every SearchBudget::interval expansions: that is
+// where it reports progress and where it notices it has been cancelled or has run out
+// of budget. A query cancelled before it starts returns without searching. The
+// solution of a stopped search has stats.stopped set, and keeps whatever it found by
+// then, as the anytime searches do.
+template <size_t N>
+class AsyncSolver {
+public:
+	using Board = Puzzle<N>;
+	using PuzzleState = typename Board::PuzzleState;
+	using Solution = typename Board::Solution;
+	using CostCalc = typename Board::CostCalc;
+	using CostUpdate = typename Board::CostUpdate;
+	using Progress = typename Board::Progress;
+	using StrategyFactory = std::function<std::shared_ptr<PuzzleStrategy>()>;
+
+	explicit AsyncSolver(const PuzzleState& goal, size_t threads = std::thread::hardware_concurrency())
+	: goal(goal), pool(threads) {}
+
+	// The query owns copies of everything it is given. Keep a copy of budget.cancel to
+	// stop it; progress is called on the thread doing the search.
+	std::future<Solution> Solve(const PuzzleState& start, StrategyFactory strategy, CostCalc valuator = nullptr,
+								CostUpdate update = nullptr, const SearchBudget& budget = SearchBudget(),
+								Progress progress = nullptr)
+	{
+		// the pool's tasks have to be copyable and a promise isn't
+		auto promise = std::make_shared<std::promise<Solution>>();
+		auto result = promise->get_future();
+		const PuzzleState target = goal;
+		pool.Submit([=] {
+			try {
+				promise->set_value(Run(target, start, strategy, valuator, update, budget, progress));
+			} catch (...) {
+				promise->set_exception(std::current_exception());
+			}
+		});
+		return result;
+	}
+
+	size_t Threads() const
+	{
+		return pool.Size();
+	}
+
+private:
+	const PuzzleState goal;
+	// last, so it finishes every query before the rest goes away
+	ThreadPool pool;
+
+	static Solution Run(const PuzzleState& goal, const PuzzleState& start, const StrategyFactory& strategy,
+						const CostCalc& valuator, const CostUpdate& update, const SearchBudget& budget,
+						const Progress& progress)
+	{
+		Solution solution;
+		if (budget.cancel.Cancelled()) {
+			solution.stats.stopped = true;
+			return solution;
+		}
+		auto search = strategy();
+		search->SetBudget(budget);
+		Board puzzle(start);
+		do {
+			puzzle = Board(start);
+			puzzle.SetLog(nullptr);
+			puzzle.SetProgress(progress);
+			solution = (valuator) ? puzzle.Solve(goal, *search, valuator, update) : puzzle.Solve(goal, *search);
+		} while (!solution && !solution.stats.stopped && search->ExpandSearch());
+		return solution;
+	}
+};
+
+#endif /* AsyncSolver_h */
@@ -0,0 +1,230 @@
+#ifndef BatchSolver_h
+#define BatchSolver_h
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Puzzle.h"
+#include "SolutionCache.h"
+#include "ThreadPool.h"
+
+// Solves many start states against one goal on a pool of threads. Every instance
+// gets its own strategy (and so its own frontier) and Solve gives each one its own
+// arena and explored table; only the goal and the heuristic are shared, and those
+// are only ever read. Given a cache, starts it has answers for aren't searched at all
+// and every shortest path found goes into it.
+template <size_t N>
+class BatchSolver {
+public:
+	using Board = Puzzle<N>;
+	using PuzzleState = typename Board::PuzzleState;
+	using CostCalc = typename Board::CostCalc;
+	using CostUpdate = typename Board::CostUpdate;
+	using StrategyFactory = std::function<std::shared_ptr<PuzzleStrategy>()>;
+
+	struct Result {
+		SearchStats stats;
+		typename Board::Moves path;
+		PuzzleState final;
+		std::chrono::microseconds time{0};
+	};
+
+	// what the solver has done across every batch so far
+	struct Stats {
+		size_t solved = 0;
+		size_t searched = 0;
+		// starts answered from the cache, starts it had no answer for, and solutions
+		// that went into it
+		size_t cacheHits = 0;
+		size_t cacheMisses = 0;
+		size_t cacheStored = 0;
+
+		friend std::ostream& operator<<(std::ostream& os, const Stats& stats)
+		{
+			os << "solved " << stats.solved << " searched " << stats.searched;
+			if (stats.cacheHits || stats.cacheMisses) {
+				os << " cache hits " << stats.cacheHits << " misses " << stats.cacheMisses
+				   << " stored " << stats.cacheStored;
+			}
+			return os;
+		}
+	};
+
+	using Source = std::function<bool(PuzzleState&)>;
+	using Sink = std::function<void(size_t, Result&)>;
+
+	BatchSolver(const PuzzleState& goal, StrategyFactory strategy, CostCalc valuator = nullptr,
+				CostUpdate update = nullptr, size_t threads = std::thread::hardware_concurrency())
+	: goal(goal), strategy(strategy), valuator(valuator), update(update), pool(threads) {}
+
+	// results come back in the same order as starts
+	std::vector<Result> Solve(const std::vector<PuzzleState>& starts)
+	{
+		std::vector<Result> results(starts.size());
+		size_t next = 0;
+		Solve([&](PuzzleState& start) {
+			if (next == starts.size()) return false;
+			start = starts[next++];
+			return true;
+		}, [&](size_t i, Result& result) {
+			results[i] = std::move(result);
+		});
+		return results;
+	}
+
+	// Pulls starts from source until it returns false and hands every result to sink,
+	// in the order the starts came in, on the calling thread. Reading carries on while
+	// the pool solves; at most window puzzles (by default 64 a thread) are held at once
+	// so the input can be as long as you like. Gives the number of puzzles read.
+	size_t Solve(const Source& source, const Sink& sink, size_t window = 0)
+	{
+		if (window == 0) {
+			window = 64 * pool.Size();
+		}
+		struct Slot {
+			bool finished = false;
+			Result result;
+		};
+		std::vector<Slot> slots(window);
+		std::mutex lock;
+		std::condition_variable ready;
+		size_t read = 0, written = 0;
+
+		// hands over every result that is ready, oldest first; waiting for the oldest if wait
+		auto Drain = [&](bool wait) {
+			while (written < read) {
+				Slot& slot = slots[written % window];
+				std::unique_lock<std::mutex> guard(lock);
+				if (!slot.finished) {
+					if (!wait) return;
+					ready.wait(guard, [&slot] { return slot.finished; });
+				}
+				Result result = std::move(slot.result);
+				slot.finished = false;
+				guard.unlock();
+				sink(written++, result);
+				wait = false;
+			}
+		};
+
+		PuzzleState start;
+		try {
+			for (;;) {
+				if (read - written == window) {
+					Drain(true);
+					continue;
+				}
+				if (!source(start)) break;
+				Slot* slot = &slots[read++ % window];
+				pool.Submit([this, start, slot, &lock, &ready] {
+					Result result = SolveOne(start);
+					// notified under the lock: once the last slot is seen to be finished
+					// Solve returns and ready, on its stack, is gone
+					std::lock_guard<std::mutex> guard(lock);
+					slot->result = std::move(result);
+					slot->finished = true;
+					ready.notify_all();
+				});
+				Drain(false);
+			}
+			while (written < read) {
+				Drain(true);
+			}
+		} catch (...) {
+			// the searches still running point at our slots so they have to finish first
+			pool.Wait();
+			throw;
+		}
+		return written;
+	}
+
+	// cache has to outlive the solver, and be for its goal; nullptr for none. Whatever
+	// is stored is served as the answer from then on, so paths only go in when shortest
+	// says the strategy always finds the shortest and the search wasn't stopped early.
+	void SetCache(SolutionCache<N>* solutions, bool shortest)
+	{
+		cache = solutions;
+		store = shortest;
+	}
+
+	Stats Counters() const
+	{
+		Stats stats;
+		stats.solved = solved.load(std::memory_order_relaxed);
+		stats.searched = searched.load(std::memory_order_relaxed);
+		stats.cacheHits = cacheHits.load(std::memory_order_relaxed);
+		stats.cacheMisses = cacheMisses.load(std::memory_order_relaxed);
+		stats.cacheStored = cacheStored.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	Result SolveOne(const PuzzleState& start) const
+	{
+		auto begin = std::chrono::steady_clock::now();
+		Result result;
+		if (cache && cache->Find(start, result.path)) {
+			++cacheHits;
+			++solved;
+			result.stats.solved = result.stats.cached = true;
+			result.stats.depth = result.path.size();
+			result.final = goal;
+			result.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+			result.stats.elapsed = result.time;
+			return result;
+		}
+		if (cache) {
+			++cacheMisses;
+		}
+		++searched;
+		Board puzzle(start);
+		auto search = strategy();
+		typename Board::Solution solution;
+		do {
+			// Solve leaves the puzzle where the search stopped so every attempt starts over
+			puzzle = Board(start);
+			puzzle.SetLog(nullptr);
+			solution = (valuator) ? puzzle.Solve(goal, *search, valuator, update) : puzzle.Solve(goal, *search);
+		} while (!solution && !solution.stats.stopped && search->ExpandSearch());
+		if (solution) {
+			++solved;
+		}
+		if (cache && store && solution && !solution.stats.stopped) {
+			cache->Insert(start, solution.path);
+			++cacheStored;
+		}
+
+		result.stats = solution.stats;
+		result.path = std::move(solution.path);
+		result.final = puzzle.State();
+		result.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+		return result;
+	}
+
+	size_t Threads() const
+	{
+		return pool.Size();
+	}
+
+private:
+	const PuzzleState goal;
+	const StrategyFactory strategy;
+	const CostCalc valuator;
+	const CostUpdate update;
+	SolutionCache<N>* cache = nullptr;
+	bool store = false;
+	// counted from the pool's threads
+	mutable std::atomic<size_t> solved{0};
+	mutable std::atomic<size_t> searched{0};
+	mutable std::atomic<size_t> cacheHits{0};
+	mutable std::atomic<size_t> cacheMisses{0};
+	mutable std::atomic<size_t> cacheStored{0};
+	ThreadPool pool;
+};
+
+#endif /* BatchSolver_h */
@@ -0,0 +1,320 @@
+// Benchmarks every search strategy over fixed sets of puzzles and writes the
+// results as Google Benchmark style JSON so runs can be compared across builds.
+//
+// Benchmark [--json <file>] [--seed <n>] [--count <n>] [--repetitions <n>]
+//           [--strategy <name>] [--pdb <3x3 database>]
+//           [--korf100 <file>] [--korf-count <n>] [--table <MB>]
+//
+// The scramble sets are drawn from a fixed seed so the same puzzles are solved on
+// every machine. The Korf 100 set isn't shipped; pass the usual file of one 15puzzle
+// per line (an optional index then sixteen tiles, 0 for the blank).
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include "BatchSolver.h"
+#include "PatternDatabase.h"
+#include "Puzzle.h"
+#include "Strategies.h"
+
+using namespace std;
+
+// the most memory the process has held so far
+size_t PeakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return static_cast<size_t>(usage.ru_maxrss);
+#else
+	// linux reports kilobytes
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+template <size_t N>
+struct InstanceSet {
+	string name;
+	typename Puzzle<N>::PuzzleState goal;
+	vector<typename Puzzle<N>::PuzzleState> starts;
+	// only these strategies are run on the set; empty runs them all
+	vector<string> strategies;
+};
+
+// count puzzles each made by a random walk of moves from the goal
+template <size_t N>
+InstanceSet<N> ScrambleSet(const typename Puzzle<N>::PuzzleState& goal, size_t moves, size_t count, mt19937& rng)
+{
+	InstanceSet<N> set;
+	set.name = "Scramble" + to_string(moves);
+	set.goal = goal;
+	for (size_t i = 0; i < count; ++i)
+	{
+		Puzzle<N> puzzle(goal);
+		puzzle.Scramble(moves, rng);
+		set.starts.push_back(puzzle.State());
+	}
+	return set;
+}
+
+// the two 8puzzle states that need the full 31 moves
+InstanceSet<3> HardestSet()
+{
+	InstanceSet<3> set;
+	set.name = "Hardest31";
+	set.goal = OrderedGoal<3>();
+	set.starts.push_back(Puzzle<3>::PuzzleState {{ { 8, 6, 7 }, { 2, 5, 4 }, { 3, 0, 1 } }});
+	set.starts.push_back(Puzzle<3>::PuzzleState {{ { 6, 4, 7 }, { 8, 5, 0 }, { 3, 2, 1 } }});
+	return set;
+}
+
+InstanceSet<4> KorfSet(const string& fileName, size_t limit)
+{
+	ifstream in(fileName);
+	if (!in) {
+		throw runtime_error("Could not open " + fileName);
+	}
+	InstanceSet<4> set;
+	set.name = "Korf100";
+	// Korf's instances are solved to the blank in the top left corner
+	for (size_t i = 0; i < set.goal.size; ++i)
+	{
+		set.goal.Set(i, static_cast<char>(i));
+	}
+	// only the informed depth first searches finish these in reasonable time
+	set.strategies = { "IterativeDeepeningManhattanDistance", "IterativeDeepeningManhattanDistanceTable" };
+	string line;
+	while (set.starts.size() < limit && getline(in, line))
+	{
+		istringstream tiles(line);
+		vector<int> values;
+		int value;
+		while (tiles >> value) {
+			values.push_back(value);
+		}
+		if (values.empty()) continue;
+		if (values.size() == 17) {
+			values.erase(values.begin());
+		}
+		if (values.size() != 16) {
+			throw runtime_error("Line " + to_string(set.starts.size() + 1) + " of " + fileName + " isn't a 15puzzle");
+		}
+		Puzzle<4>::PuzzleState state;
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			state.Set(i, static_cast<char>(values[i]));
+		}
+		set.starts.push_back(state);
+	}
+	return set;
+}
+
+struct Options {
+	string json;
+	unsigned long seed = 2016;
+	size_t count = 50;
+	size_t repetitions = 1;
+	string strategy;
+	string korf;
+	size_t korfCount = 100;
+	// transposition table for the searches that keep one, to weigh memory against nodes
+	size_t table = defaultTableMegabytes;
+};
+
+// one strategy over one instance set
+struct Measurement {
+	string name;
+	size_t iterations = 0;
+	size_t solved = 0;
+	size_t expanded = 0;
+	size_t peakBytes = 0;
+	size_t peakResident = 0;
+	chrono::microseconds total{0};
+	chrono::microseconds longest{0};
+	double cpu = 0;
+};
+
+double CpuSeconds()
+{
+	return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+}
+
+template <size_t N>
+void RunSet(const InstanceSet<N>& set, const PatternDatabase<N>* pdb, const Options& options, vector<Measurement>& results)
+{
+	for (auto& package : Strategies<N>(set.goal, pdb, options.table)) {
+		const string& strategyName = get<1>(package);
+		if (!options.strategy.empty() && strategyName != options.strategy) continue;
+		if (!set.strategies.empty() && find(set.strategies.begin(), set.strategies.end(), strategyName) == set.strategies.end()) continue;
+
+		// the batch solver on one thread gives each instance a fresh strategy without
+		// the threads getting in the way of the timings
+		BatchSolver<N> solver(set.goal, get<0>(package), get<2>(package), get<3>(package), 1);
+		Measurement m;
+		m.name = set.name + "/" + strategyName;
+		cerr << "Running " << m.name << endl;
+		const double cpuBegin = CpuSeconds();
+		for (size_t r = 0; r < options.repetitions; ++r)
+		{
+			for (const auto& start : set.starts)
+			{
+				auto result = solver.SolveOne(start);
+				++m.iterations;
+				m.solved += result.stats.solved;
+				m.expanded += result.stats.expanded;
+				m.peakBytes = max(m.peakBytes, result.stats.bytes);
+				m.total += result.time;
+				m.longest = max(m.longest, result.time);
+			}
+		}
+		m.cpu = CpuSeconds() - cpuBegin;
+		m.peakResident = PeakResidentBytes();
+		results.push_back(m);
+	}
+}
+
+string Escape(const string& s)
+{
+	string out;
+	for (char c : s) {
+		if (c == '"' || c == '\\') out += '\\';
+		out += c;
+	}
+	return out;
+}
+
+void WriteJson(ostream& os, const Options& options, const vector<Measurement>& results, const string& executable)
+{
+	char date[64] = "";
+	const time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+	os << "{\n";
+	os << "  \"context\": {\n";
+	os << "    \"date\": \"" << date << "\",\n";
+	os << "    \"executable\": \"" << Escape(executable) << "\",\n";
+	os << "    \"num_cpus\": " << thread::hardware_concurrency() << ",\n";
+	os << "    \"seed\": " << options.seed << ",\n";
+	os << "    \"instances_per_set\": " << options.count << ",\n";
+	os << "    \"table_megabytes\": " << options.table << ",\n";
+#if defined(DEBUG) || defined(_DEBUG)
+	os << "    \"library_build_type\": \"debug\"\n";
+#else
+	os << "    \"library_build_type\": \"release\"\n";
+#endif
+	os << "  },\n";
+	os << "  \"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const auto& m = results[i];
+		const double perIteration = (m.iterations) ? double(m.total.count()) / m.iterations : 0;
+		const double seconds = m.total.count() / 1e6;
+		os << ((i) ? "," : "") << "\n    {\n";
+		os << "      \"name\": \"" << Escape(m.name) << "\",\n";
+		os << "      \"run_type\": \"iteration\",\n";
+		os << "      \"iterations\": " << m.iterations << ",\n";
+		os << "      \"real_time\": " << perIteration << ",\n";
+		os << "      \"cpu_time\": " << ((m.iterations) ? m.cpu * 1e6 / m.iterations : 0) << ",\n";
+		os << "      \"time_unit\": \"us\",\n";
+		os << "      \"max_time\": " << m.longest.count() << ",\n";
+		os << "      \"solved\": " << m.solved << ",\n";
+		os << "      \"nodes_expanded\": " << m.expanded << ",\n";
+		os << "      \"nodes_per_second\": " << ((seconds > 0) ? m.expanded / seconds : 0) << ",\n";
+		os << "      \"peak_bytes\": " << m.peakBytes << ",\n";
+		os << "      \"peak_rss_bytes\": " << m.peakResident << "\n";
+		os << "    }";
+	}
+	os << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+	const vector<string> args(argv + 1, argv + argc);
+	Options options;
+	unique_ptr<PatternDatabase<3>> pdb;
+	vector<Measurement> results;
+	try {
+		for (size_t i = 0; i + 1 < args.size(); i += 2)
+		{
+			if (args[i] == "--json") {
+				options.json = args[i + 1];
+			} else if (args[i] == "--seed") {
+				options.seed = stoul(args[i + 1]);
+			} else if (args[i] == "--count") {
+				options.count = stoul(args[i + 1]);
+			} else if (args[i] == "--repetitions") {
+				options.repetitions = max<size_t>(stoul(args[i + 1]), 1);
+			} else if (args[i] == "--strategy") {
+				options.strategy = args[i + 1];
+			} else if (args[i] == "--pdb") {
+				pdb.reset(new PatternDatabase<3>(args[i + 1]));
+			} else if (args[i] == "--korf100") {
+				options.korf = args[i + 1];
+			} else if (args[i] == "--korf-count") {
+				options.korfCount = stoul(args[i + 1]);
+			} else if (args[i] == "--table") {
+				options.table = stoul(args[i + 1]);
+			} else {
+				cerr << "Unknown option " << args[i] << endl;
+				return 1;
+			}
+		}
+
+		// read up front so a bad file is reported before anything is run
+		InstanceSet<4> korf;
+		if (!options.korf.empty()) {
+			korf = KorfSet(options.korf, options.korfCount);
+		}
+
+		mt19937 rng(options.seed);
+		for (size_t moves : { 10, 20, 40, 80 }) {
+			RunSet<3>(ScrambleSet<3>(OrderedGoal<3>(), moves, options.count, rng), pdb.get(), options, results);
+		}
+		RunSet<3>(HardestSet(), pdb.get(), options, results);
+		if (!korf.starts.empty()) {
+			RunSet<4>(korf, nullptr, options, results);
+		}
+	} catch (const exception& e) {
+		cerr << e.what() << endl;
+		return 1;
+	}
+
+	if (options.json.empty()) {
+		WriteJson(cout, options, results, argv[0]);
+	} else {
+		ofstream out(options.json);
+		if (!out) {
+			cerr << "Could not write " << options.json << endl;
+			return 1;
+		}
+		WriteJson(out, options, results, argv[0]);
+	}
+	return 0;
+}
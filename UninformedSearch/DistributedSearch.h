@@ -0,0 +1,491 @@
+#ifndef DistributedSearch_h
+#define DistributedSearch_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Socket.h"
+#include "StateTable.h"
+
+// Breadth first search across machines, for spaces whose layers don't fit in one. Every
+// node runs the same search with the same list of peers and owns the states whose hash
+// lands on its place in the list, so each state is kept and deduplicated on exactly one
+// node, and the space as a whole is held by all of them together.
+//
+// As in LayeredSearch.h a layer is a sorted run of packed states with no closed list
+// kept, and only the previous layer is needed to tell a child is new. A node expands
+// the part of the layer it owns and hands each child to its owner. Children bound for
+// the same node are batched, and a batch goes out as the states' permutation ranks
+// (see StateTable.h), sorted, each sent as the gap from the one before in as few bytes
+// as it needs: ranks are dense where packed boards are not, so the gaps are short and
+// a state costs around half the eight bytes it takes in memory.
+//
+// Every layer ends at a barrier. A node that has sent all of its children tells every
+// peer so; once it has heard the same from all of them it has its whole share of the
+// next layer, deduplicates it and adds its size into a sum every node works out, which
+// says whether there is another layer and, when looking for a goal, whether it has
+// been reached.
+//
+// The connections form a full mesh: every node listens on the port of its own entry
+// and connects to the nodes listed before it. Messages are in the byte order of the
+// machines, which all have to share one.
+template <class Board>
+class DistributedBreadthFirst {
+public:
+	using PuzzleState = typename Board::PuzzleState;
+	using Key = uint64_t;
+	using LayerCallback = std::function<void(size_t depth, size_t states)>;
+
+	// the ranks have to fit a word as well as the boards
+	static_assert(PuzzleState::size <= 16, "A distributed search needs a board of 16 cells or fewer");
+
+	struct Result {
+		bool solved = false;
+		size_t depth = 0;
+		// states first reached at each depth, across every node
+		std::vector<size_t> layers;
+		// this node's part
+		size_t owned = 0;
+		size_t expanded = 0;
+		size_t generated = 0;
+		// states held in this node's layers at once
+		size_t peakStates = 0;
+		// children sent to other nodes, the batches they went in, and the bytes on the
+		// wire both ways, barriers included; the goodbye at the end is no search's
+		size_t sent = 0;
+		size_t messages = 0;
+		size_t bytesSent = 0;
+		size_t bytesReceived = 0;
+		std::chrono::steady_clock::duration elapsed{0};
+	};
+
+	// peers is host:port for every node, the same on each; rank is this node's entry.
+	// Connecting waits up to wait for the other nodes to start.
+	DistributedBreadthFirst(const std::vector<std::string>& peers, size_t rank,
+							std::chrono::seconds wait = std::chrono::seconds(120))
+	: rank(rank), nodes(peers.size()), links(peers.size())
+	{
+		if (rank >= nodes) {
+			throw std::logic_error("The node's rank has to be one of the peers");
+		}
+		Socket listener;
+		if (rank + 1 < nodes) {
+			listener = Socket::Listen(Port(peers[rank]));
+		}
+		const auto deadline = std::chrono::steady_clock::now() + wait;
+		for (size_t j = 0; j < rank; ++j)
+		{
+			while (!(links[j] = Socket::Connect(Host(peers[j]), Port(peers[j]))).Valid()) {
+				if (std::chrono::steady_clock::now() > deadline) {
+					throw std::runtime_error("Could not connect to " + peers[j]);
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+			const uint32_t hello[2] = { magic, static_cast<uint32_t>(rank) };
+			links[j].SendAll(hello, sizeof(hello));
+		}
+		for (size_t j = rank + 1; j < nodes; ++j)
+		{
+			Socket socket = listener.Accept();
+			uint32_t hello[2];
+			if (!socket.ReceiveAll(hello, sizeof(hello)) || hello[0] != magic || hello[1] <= rank ||
+				hello[1] >= nodes || links[hello[1]].Valid()) {
+				throw std::runtime_error("Something that isn't part of the search connected");
+			}
+			links[hello[1]] = std::move(socket);
+		}
+		for (size_t j = 0; j < nodes; ++j)
+		{
+			if (j != rank) {
+				readers.emplace_back([this, j] { Read(j); });
+			}
+		}
+	}
+
+	DistributedBreadthFirst(const DistributedBreadthFirst&) = delete;
+	DistributedBreadthFirst& operator=(const DistributedBreadthFirst&) = delete;
+
+	// After a search that finished every node leaves the same way: it says goodbye to
+	// each peer and reads until each has done the same, so nobody takes a node that is
+	// done for one that has failed. After one that didn't the connections are just cut.
+	~DistributedBreadthFirst()
+	{
+		if (finished) {
+			try {
+				for (size_t j = 0; j < nodes; ++j)
+				{
+					if (j != rank) {
+						const Header header = { BYE, 0, 0 };
+						links[j].SendAll(&header, sizeof(header));
+						links[j].ShutdownSending();
+					}
+				}
+			} catch (const std::exception&) {
+				finished = false;
+			}
+		}
+		if (!finished) {
+			closing = true;
+			for (auto& link : links)
+			{
+				link.Shutdown();
+			}
+		}
+		for (auto& reader : readers)
+		{
+			reader.join();
+		}
+	}
+
+	size_t Rank() const
+	{
+		return rank;
+	}
+
+	size_t Nodes() const
+	{
+		return nodes;
+	}
+
+	// every state reachable from start; the radius of the space is the depth of the
+	// result. each is called on every node with the size of each layer
+	Result Enumerate(const PuzzleState& start, const LayerCallback& each = nullptr)
+	{
+		return Search(start, nullptr, each);
+	}
+
+	// how far goal is from start; there is no closed list to find the path in
+	Result Solve(const PuzzleState& start, const PuzzleState& goal)
+	{
+		return Search(start, &goal, nullptr);
+	}
+
+private:
+	enum Type : uint32_t { KEYS = 1, END = 2, SUMS = 3, BYE = 4 };
+
+	struct Header {
+		uint32_t type;
+		uint32_t count;
+		uint64_t bytes;
+	};
+
+	static constexpr uint32_t magic = 0x50555A44;
+	// children held for another node before they go out
+	static constexpr size_t batch = size_t(1) << 16;
+	// what a barrier adds up: the size of the next layer and whether it holds the goal
+	static constexpr size_t sums = 2;
+
+	using Ranking = PermutationRank<PuzzleState>;
+
+	const size_t rank;
+	const size_t nodes;
+	std::vector<Socket> links;
+	std::vector<std::thread> readers;
+	// set while no search has failed partway, so the peers are in step
+	bool finished = true;
+	std::atomic<bool> closing{false};
+
+	// what the readers have taken off the wire for the search
+	std::mutex lock;
+	std::condition_variable arrived;
+	std::vector<Key> incoming;
+	size_t ends = 0;
+	size_t reports = 0;
+	uint64_t totals[sums] = {};
+	// bytes that came in ahead of the barrier reports counted so far
+	size_t received = 0;
+	std::string failure;
+
+	static std::string Host(const std::string& peer)
+	{
+		const size_t colon = peer.rfind(':');
+		if (colon == std::string::npos) {
+			throw std::runtime_error(peer + " should be host:port");
+		}
+		return peer.substr(0, colon);
+	}
+
+	static unsigned short Port(const std::string& peer)
+	{
+		const size_t colon = peer.rfind(':');
+		if (colon == std::string::npos) {
+			throw std::runtime_error(peer + " should be host:port");
+		}
+		return static_cast<unsigned short>(std::stoul(peer.substr(colon + 1)));
+	}
+
+	size_t Owner(const PuzzleState& state) const
+	{
+		return state.hash() % nodes;
+	}
+
+	Result Search(const PuzzleState& start, const PuzzleState* goal, const LayerCallback& each)
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		finished = false;
+		Result result;
+		std::vector<Key> previous, current, next;
+		if (Owner(start) == rank) {
+			current.push_back(start.Key());
+		}
+		size_t layer = 1;
+		bool reached = goal && start == *goal;
+		result.layers.push_back(layer);
+		if (each) {
+			each(0, layer);
+		}
+		while (!reached) {
+			result.owned += current.size();
+			Expand(previous, current, next, result);
+			result.peakStates = std::max(result.peakStates, previous.size() + current.size() + next.size());
+
+			uint64_t counts[sums] = { next.size(), 0 };
+			counts[1] = goal && Owner(*goal) == rank && std::binary_search(next.begin(), next.end(), goal->Key());
+			Barrier(counts, result);
+			previous.swap(current);
+			current.swap(next);
+			next.clear();
+			layer = static_cast<size_t>(counts[0]);
+			reached = counts[1] != 0;
+			if (!layer) break;
+			result.layers.push_back(layer);
+			if (each) {
+				each(result.layers.size() - 1, layer);
+			}
+		}
+		result.owned += current.size();
+		result.solved = !goal || reached;
+		result.depth = result.layers.size() - 1;
+		result.elapsed = std::chrono::steady_clock::now() - begin;
+		finished = true;
+		return result;
+	}
+
+	// this node's share of the layer after current, less anything in previous
+	void Expand(const std::vector<Key>& previous, const std::vector<Key>& current, std::vector<Key>& next, Result& result)
+	{
+		std::vector<std::vector<Key>> outbox(nodes);
+		for (Key key : current)
+		{
+			const PuzzleState state = PuzzleState::FromKey(key);
+			const auto& moves = Board::Neighbours::cells[state.Blank()];
+			for (size_t i = 0; i < moves.count; ++i)
+			{
+				PuzzleState child = state;
+				child.Slide(moves.target[moves.moves[i]]);
+				const size_t owner = Owner(child);
+				if (owner == rank) {
+					next.push_back(child.Key());
+					continue;
+				}
+				outbox[owner].push_back(Ranking::Rank(child));
+				if (outbox[owner].size() == batch) {
+					SendKeys(owner, outbox[owner], result);
+				}
+			}
+			++result.expanded;
+			result.generated += moves.count;
+		}
+		for (size_t j = 0; j < nodes; ++j)
+		{
+			if (j == rank) continue;
+			if (!outbox[j].empty()) {
+				SendKeys(j, outbox[j], result);
+			}
+			Send(j, END, 0, nullptr, 0, result);
+		}
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			arrived.wait(guard, [this] { return ends == nodes - 1 || !failure.empty(); });
+			Check();
+			next.insert(next.end(), incoming.begin(), incoming.end());
+			incoming.clear();
+			incoming.shrink_to_fit();
+			ends = 0;
+		}
+
+		// bipartite, as LayeredSearch.h explains, so only the previous layer can hold them
+		std::sort(next.begin(), next.end());
+		next.erase(std::unique(next.begin(), next.end()), next.end());
+		size_t kept = 0;
+		auto seen = previous.begin();
+		for (Key key : next)
+		{
+			seen = std::lower_bound(seen, previous.end(), key);
+			if (seen != previous.end() && *seen == key) continue;
+			next[kept++] = key;
+		}
+		next.resize(kept);
+	}
+
+	// adds counts up across every node, so they all leave with the same totals
+	void Barrier(uint64_t (&counts)[sums], Result& result)
+	{
+		for (size_t j = 0; j < nodes; ++j)
+		{
+			if (j != rank) {
+				Send(j, SUMS, sums, counts, sizeof(counts), result);
+			}
+		}
+		std::unique_lock<std::mutex> guard(lock);
+		arrived.wait(guard, [this] { return reports == nodes - 1 || !failure.empty(); });
+		Check();
+		for (size_t i = 0; i < sums; ++i)
+		{
+			counts[i] += totals[i];
+			totals[i] = 0;
+		}
+		reports = 0;
+		result.bytesReceived += received;
+		received = 0;
+	}
+
+	// throws what went wrong on a reader's thread; lock is held
+	void Check() const
+	{
+		if (!failure.empty()) {
+			throw std::runtime_error(failure);
+		}
+	}
+
+	// ranks sorted, then each as its gap from the last, seven bits to a byte with the
+	// top bit saying more follow
+	void SendKeys(size_t peer, std::vector<Key>& ranks, Result& result)
+	{
+		std::sort(ranks.begin(), ranks.end());
+		std::vector<unsigned char> bytes;
+		bytes.reserve(ranks.size() * 5);
+		Key last = 0;
+		for (Key key : ranks)
+		{
+			Key gap = key - last;
+			last = key;
+			while (gap >= 0x80) {
+				bytes.push_back(static_cast<unsigned char>(gap | 0x80));
+				gap >>= 7;
+			}
+			bytes.push_back(static_cast<unsigned char>(gap));
+		}
+		result.sent += ranks.size();
+		++result.messages;
+		Send(peer, KEYS, static_cast<uint32_t>(ranks.size()), bytes.data(), bytes.size(), result);
+		ranks.clear();
+	}
+
+	void Send(size_t peer, Type type, uint32_t count, const void* payload, size_t bytes, Result& result)
+	{
+		const Header header = { type, count, bytes };
+		links[peer].SendAll(&header, sizeof(header));
+		if (bytes) {
+			links[peer].SendAll(payload, bytes);
+		}
+		result.bytesSent += sizeof(header) + bytes;
+	}
+
+	// Runs on a thread of its own for each peer, so nothing a peer sends ever waits on
+	// the search to read it and two nodes sending to each other can't both block.
+	// Everything a peer sends for a layer comes before its barrier report, so the bytes
+	// are handed over with the report and a peer already on to the next search can't
+	// have its bytes counted in this one.
+	void Read(size_t peer)
+	{
+		try {
+			Header header;
+			std::vector<unsigned char> payload;
+			std::vector<Key> keys;
+			size_t bytes = 0;
+			bool leaving = false;
+			while (links[peer].ReceiveAll(&header, sizeof(header))) {
+				payload.resize(static_cast<size_t>(header.bytes));
+				if (header.bytes && !links[peer].ReceiveAll(payload.data(), payload.size())) {
+					throw std::runtime_error("A message from node " + std::to_string(peer) + " was cut short");
+				}
+				if (header.type == KEYS) {
+					Decode(payload, header.count, keys);
+				} else if (header.type == BYE) {
+					leaving = true;
+					continue;
+				}
+				bytes += sizeof(header) + payload.size();
+				std::lock_guard<std::mutex> guard(lock);
+				switch (header.type) {
+					case KEYS:
+						incoming.insert(incoming.end(), keys.begin(), keys.end());
+						break;
+					case END:
+						++ends;
+						break;
+					case SUMS: {
+						if (payload.size() != sizeof(uint64_t) * sums) {
+							throw std::runtime_error("Node " + std::to_string(peer) + " sent a bad barrier");
+						}
+						uint64_t counts[sums];
+						std::memcpy(counts, payload.data(), sizeof(counts));
+						for (size_t i = 0; i < sums; ++i)
+						{
+							totals[i] += counts[i];
+						}
+						++reports;
+						received += bytes;
+						bytes = 0;
+						break;
+					}
+					default:
+						throw std::runtime_error("Node " + std::to_string(peer) + " sent a message this node doesn't know");
+				}
+				arrived.notify_all();
+			}
+			if (!leaving && !closing) {
+				throw std::runtime_error("Node " + std::to_string(peer) + " left the search");
+			}
+		} catch (const std::exception& e) {
+			if (closing) return;
+			std::lock_guard<std::mutex> guard(lock);
+			if (failure.empty()) {
+				failure = e.what();
+			}
+			arrived.notify_all();
+		}
+	}
+
+	void Decode(const std::vector<unsigned char>& bytes, uint32_t count, std::vector<Key>& keys) const
+	{
+		keys.clear();
+		keys.reserve(count);
+		Key last = 0;
+		size_t at = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Key gap = 0;
+			for (unsigned shift = 0;; shift += 7)
+			{
+				if (at == bytes.size() || shift > 63) {
+					throw std::runtime_error("A batch of states arrived corrupt");
+				}
+				const unsigned char byte = bytes[at++];
+				gap |= Key(byte & 0x7F) << shift;
+				if (!(byte & 0x80)) break;
+			}
+			last += gap;
+			if (last >= Ranking::Count()) {
+				throw std::runtime_error("A batch of states arrived corrupt");
+			}
+			keys.push_back(Ranking::Unrank(last).Key());
+		}
+	}
+};
+
+template <class Board>
+constexpr uint32_t DistributedBreadthFirst<Board>::magic;
+
+#endif /* DistributedSearch_h */
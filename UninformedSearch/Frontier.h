@@ -0,0 +1,257 @@
+#ifndef Frontier_h
+#define Frontier_h
+
+#include <cassert>
+#include <vector>
+
+#include "PageMemory.h"
+
+// First in, first out. A power of two ring buffer so pushes and pops are an index
+// and a mask, and memory is reused as the queue drains.
+template <class Entry>
+class RingQueue {
+public:
+	void push(const Entry& entry)
+	{
+		if (count == slots.size()) {
+			Grow();
+		}
+		slots[(head + count++) & (slots.size() - 1)] = entry;
+	}
+
+	void pop()
+	{
+		assert(count);
+		head = (head + 1) & (slots.size() - 1);
+		--count;
+	}
+
+	const Entry& top() const
+	{
+		assert(count);
+		return slots[head];
+	}
+
+	bool empty() const
+	{
+		return count == 0;
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	void clear()
+	{
+		head = count = 0;
+	}
+
+private:
+	std::vector<Entry, PageAllocator<Entry>> slots;
+	size_t head = 0;
+	size_t count = 0;
+
+	void Grow()
+	{
+		decltype(slots) bigger(slots.empty() ? 1024 : slots.size() * 2);
+		for (size_t i = 0; i < count; ++i)
+		{
+			bigger[i] = slots[(head + i) & (slots.size() - 1)];
+		}
+		slots.swap(bigger);
+		head = 0;
+	}
+};
+
+// Last in, first out.
+template <class Entry>
+class StackQueue {
+public:
+	void push(const Entry& entry)
+	{
+		entries.push_back(entry);
+	}
+
+	void pop()
+	{
+		entries.pop_back();
+	}
+
+	const Entry& top() const
+	{
+		return entries.back();
+	}
+
+	bool empty() const
+	{
+		return entries.empty();
+	}
+
+	size_t size() const
+	{
+		return entries.size();
+	}
+
+	void clear()
+	{
+		entries.clear();
+	}
+
+private:
+	std::vector<Entry, PageAllocator<Entry>> entries;
+};
+
+// Lowest cost first. Costs are small integers so each one gets its own bucket--
+// pushes append to a bucket and pops take from the cheapest non empty one.
+// Within a bucket the newest entry wins, which favors deeper nodes on ties.
+template <class Entry>
+class BucketQueue {
+public:
+	void push(const Entry& entry)
+	{
+		if (entry.cost >= buckets.size()) {
+			buckets.resize(entry.cost + 1);
+		}
+		buckets[entry.cost].push_back(entry);
+		if (count++ == 0 || entry.cost < lowest) {
+			lowest = entry.cost;
+		}
+	}
+
+	void pop()
+	{
+		assert(count);
+		buckets[lowest].pop_back();
+		if (--count) {
+			while (buckets[lowest].empty()) {
+				++lowest;
+			}
+		}
+	}
+
+	const Entry& top() const
+	{
+		assert(count);
+		return buckets[lowest].back();
+	}
+
+	bool empty() const
+	{
+		return count == 0;
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	void clear()
+	{
+		for (auto& bucket : buckets)
+		{
+			bucket.clear();
+		}
+		count = lowest = 0;
+	}
+
+private:
+	std::vector<std::vector<Entry, PageAllocator<Entry>>> buckets;
+	size_t lowest = 0;
+	size_t count = 0;
+};
+
+// The frontier a strategy searches with. The ordering is fixed when the strategy
+// is built; every operation is a switch on it (which the branch predictor learns in
+// a few iterations) and then an O(1) operation on a concrete container.
+template <class Entry>
+class Frontier {
+public:
+	enum Policy {
+		FIFO,
+		LIFO,
+		LOWEST_COST
+	};
+
+	explicit Frontier(Policy policy)
+	: policy(policy) {}
+
+	Policy Order() const
+	{
+		return policy;
+	}
+
+	void push(const Entry& entry)
+	{
+		switch (policy)
+		{
+			case FIFO:
+				return fifo.push(entry);
+			case LIFO:
+				return lifo.push(entry);
+			case LOWEST_COST:
+				return lowest.push(entry);
+		}
+	}
+
+	void pop()
+	{
+		switch (policy)
+		{
+			case FIFO:
+				return fifo.pop();
+			case LIFO:
+				return lifo.pop();
+			case LOWEST_COST:
+				return lowest.pop();
+		}
+	}
+
+	const Entry& top() const
+	{
+		switch (policy)
+		{
+			case FIFO:
+				return fifo.top();
+			case LIFO:
+				return lifo.top();
+			case LOWEST_COST:
+			default:
+				return lowest.top();
+		}
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	size_t size() const
+	{
+		switch (policy)
+		{
+			case FIFO:
+				return fifo.size();
+			case LIFO:
+				return lifo.size();
+			case LOWEST_COST:
+			default:
+				return lowest.size();
+		}
+	}
+
+	void clear()
+	{
+		fifo.clear();
+		lifo.clear();
+		lowest.clear();
+	}
+
+private:
+	Policy policy;
+	RingQueue<Entry> fifo;
+	StackQueue<Entry> lifo;
+	BucketQueue<Entry> lowest;
+};
+
+#endif /* Frontier_h */
@@ -0,0 +1,479 @@
+#ifndef Heuristics_h
+#define Heuristics_h
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Puzzle.h"
+#include "Simd.h"
+
+// Heuristics precompute a table of what every tile contributes in every cell for
+// their goal. Estimate scores a board from scratch; Update takes the parent's score
+// and the move that made the child and adjusts for the one tile that moved, in O(1).
+// Called as a CostCalc they return the A* cost (moves so far plus the estimate).
+
+template <size_t N>
+class ManhattanDistance {
+public:
+	using Board = Puzzle<N>;
+	using PuzzleState = typename Board::PuzzleState;
+	using MOVE = typename Board::MOVE;
+
+	explicit ManhattanDistance(const PuzzleState& goal)
+	: goal(goal)
+	{
+		for (size_t tile = 0; tile < PuzzleState::size; ++tile)
+		{
+			const size_t home = goal.Find(static_cast<char>(tile));
+			assert(home != PuzzleState::size);
+			for (size_t cell = 0; cell < PuzzleState::size; ++cell)
+			{
+				// blank tile is not included
+				distance[tile][cell] = (tile == 0) ? 0 : static_cast<unsigned char>(
+					std::abs(int(home / N) - int(cell / N)) + std::abs(int(home % N) - int(cell % N)));
+			}
+		}
+
+		vector = packed && Simd::Supported();
+		std::memset(&tables, 0, sizeof(tables));
+		for (size_t i = 0; i < PuzzleState::size && packed; ++i)
+		{
+			const size_t home = goal.Find(static_cast<char>(i));
+			tables.tileRow[i] = static_cast<uint8_t>(home / N);
+			tables.tileCol[i] = static_cast<uint8_t>(home % N);
+			tables.cellRow[i] = static_cast<uint8_t>(i / N);
+			tables.cellCol[i] = static_cast<uint8_t>(i % N);
+		}
+	}
+
+	const PuzzleState& Goal() const
+	{
+		return goal;
+	}
+
+	int Estimate(const PuzzleState& state) const
+	{
+		if (vector) {
+			return Simd::Manhattan(Key(state, std::integral_constant<bool, packed>()), tables);
+		}
+		int h = 0;
+		for (size_t cell = 0; cell < PuzzleState::size; ++cell)
+		{
+			h += distance[static_cast<size_t>(state.Get(cell))][cell];
+		}
+		return h;
+	}
+
+	// the tile the blank swaps with is the only one that moves
+	int Update(int h, const PuzzleState& parent, MOVE m) const
+	{
+		const size_t from = Board::Neighbours::cells[parent.Blank()].target[m];
+		assert(from != Board::npos);
+		const auto tile = static_cast<size_t>(parent.Get(from));
+		return h - distance[tile][from] + distance[tile][parent.Blank()];
+	}
+
+	int operator()(const PuzzleState& state, const PuzzleState& target, int cumulativeCost) const
+	{
+		// the tables are only good for our own goal
+		if (!(target == goal)) {
+			return ManhattanDistance(target)(state, target, cumulativeCost);
+		}
+		return Estimate(state) + cumulativeCost;
+	}
+
+private:
+	// only boards that pack into a word can be scored a word at a time
+	static constexpr bool packed = PuzzleState::size <= 16;
+
+	PuzzleState goal;
+	unsigned char distance[PuzzleState::size][PuzzleState::size];
+	Simd::ManhattanTables tables;
+	bool vector = false;
+
+	static uint64_t Key(const PuzzleState& state, std::true_type)
+	{
+		return state.Key();
+	}
+
+	static uint64_t Key(const PuzzleState&, std::false_type)
+	{
+		return 0;
+	}
+};
+
+template <size_t N>
+class MisplacedTiles {
+public:
+	using Board = Puzzle<N>;
+	using PuzzleState = typename Board::PuzzleState;
+	using MOVE = typename Board::MOVE;
+
+	explicit MisplacedTiles(const PuzzleState& goal)
+	: goal(goal) {}
+
+	const PuzzleState& Goal() const
+	{
+		return goal;
+	}
+
+	int Estimate(const PuzzleState& state) const
+	{
+		int count = 0;
+		// blank tile is not included
+		for (size_t cell = 0; cell < PuzzleState::size; ++cell)
+		{
+			count += Misplaced(state.Get(cell), cell);
+		}
+		assert(count >= 0 && size_t(count) < PuzzleState::size);
+		return count;
+	}
+
+	int Update(int h, const PuzzleState& parent, MOVE m) const
+	{
+		const size_t from = Board::Neighbours::cells[parent.Blank()].target[m];
+		assert(from != Board::npos);
+		const auto tile = parent.Get(from);
+		return h - Misplaced(tile, from) + Misplaced(tile, parent.Blank());
+	}
+
+	int operator()(const PuzzleState& state, const PuzzleState& target, int cumulativeCost) const
+	{
+		if (!(target == goal)) {
+			return MisplacedTiles(target)(state, target, cumulativeCost);
+		}
+		return Estimate(state) + cumulativeCost;
+	}
+
+private:
+	PuzzleState goal;
+
+	int Misplaced(char tile, size_t cell) const
+	{
+		return tile && goal.Get(cell) != tile;
+	}
+};
+
+// Manhattan distance plus linear conflicts (Hansson, Mayer & Yung). Two tiles that both
+// belong in the line (row or column) they are in, but in the wrong order, can't pass
+// each other without one of them stepping out of the line and back, two more moves. A
+// line needs as many of its tiles to step aside as aren't in its longest run in the
+// right order, and rows and columns can be added up (Korf & Taylor). A line is encoded
+// as a digit for each of its cells, base N + 1: where along the line its tile belongs,
+// plus one, if it belongs in this line and 0 otherwise. Its penalty is then one lookup
+// in a table of (N + 1)^N entries.
+template <size_t N>
+class LinearConflict {
+public:
+	using Board = Puzzle<N>;
+	using PuzzleState = typename Board::PuzzleState;
+	using MOVE = typename Board::MOVE;
+
+	explicit LinearConflict(const PuzzleState& goal)
+	: manhattan(goal)
+	{
+		for (size_t tile = 0; tile < PuzzleState::size; ++tile)
+		{
+			const size_t home = goal.Find(static_cast<char>(tile));
+			// the blank belongs in no line
+			homeRow[tile] = static_cast<unsigned char>((tile == 0) ? N : home / N);
+			homeCol[tile] = static_cast<unsigned char>((tile == 0) ? N : home % N);
+		}
+
+		std::vector<unsigned char> table(Codes());
+		for (size_t code = 0; code < Codes(); ++code)
+		{
+			size_t digits[N];
+			for (size_t i = N, rest = code; i-- > 0; rest /= (N + 1))
+			{
+				digits[i] = rest % (N + 1);
+			}
+			// longest run in the right order, in N^2 since N is at most a handful
+			size_t run[N], longest = 0, tiles = 0;
+			for (size_t i = 0; i < N; ++i)
+			{
+				run[i] = 0;
+				if (!digits[i]) continue;
+				++tiles;
+				run[i] = 1;
+				for (size_t j = 0; j < i; ++j)
+				{
+					if (digits[j] && digits[j] < digits[i]) {
+						run[i] = std::max(run[i], run[j] + 1);
+					}
+				}
+				longest = std::max(longest, run[i]);
+			}
+			table[code] = static_cast<unsigned char>(2 * (tiles - longest));
+		}
+		penalty = std::make_shared<const std::vector<unsigned char>>(std::move(table));
+	}
+
+	const PuzzleState& Goal() const
+	{
+		return manhattan.Goal();
+	}
+
+	int Estimate(const PuzzleState& state) const
+	{
+		int h = manhattan.Estimate(state);
+		for (size_t line = 0; line < N; ++line)
+		{
+			h += Penalty(state, line, false) + Penalty(state, line, true);
+		}
+		return h;
+	}
+
+	// The tile that moves leaves one line and joins another across the move, and moves
+	// along the line it stays in, so only those three lines are looked at again.
+	int Update(int h, const PuzzleState& parent, MOVE m) const
+	{
+		const size_t blank = parent.Blank();
+		const size_t from = Board::Neighbours::cells[blank].target[m];
+		assert(from != Board::npos);
+		PuzzleState child = parent;
+		child.Slide(from);
+
+		h = manhattan.Update(h, parent, m);
+		const bool vertical = (from % N == blank % N);
+		const size_t along = (vertical) ? from % N : from / N;
+		const size_t left = (vertical) ? from / N : from % N;
+		const size_t joined = (vertical) ? blank / N : blank % N;
+		h += Penalty(child, along, vertical) - Penalty(parent, along, vertical);
+		h += Penalty(child, left, !vertical) - Penalty(parent, left, !vertical);
+		h += Penalty(child, joined, !vertical) - Penalty(parent, joined, !vertical);
+		return h;
+	}
+
+	int operator()(const PuzzleState& state, const PuzzleState& target, int cumulativeCost) const
+	{
+		// anything but our own goal gets the next best admissible estimate
+		if (!(target == Goal())) {
+			return ManhattanDistance<N>(target)(state, target, cumulativeCost);
+		}
+		return Estimate(state) + cumulativeCost;
+	}
+
+private:
+	ManhattanDistance<N> manhattan;
+	// shared by the copies every CostCalc makes
+	std::shared_ptr<const std::vector<unsigned char>> penalty;
+	unsigned char homeRow[PuzzleState::size];
+	unsigned char homeCol[PuzzleState::size];
+
+	static constexpr size_t Codes(size_t n = N)
+	{
+		return (n == 0) ? 1 : (N + 1) * Codes(n - 1);
+	}
+
+	// the penalty for a row, or for a column if column
+	int Penalty(const PuzzleState& state, size_t line, bool column) const
+	{
+		size_t code = 0;
+		for (size_t i = 0; i < N; ++i)
+		{
+			const size_t tile = size_t(state.Get((column) ? i * N + line : line * N + i));
+			const bool belongs = ((column) ? homeCol[tile] : homeRow[tile]) == line;
+			code = code * (N + 1) + ((belongs) ? ((column) ? homeRow[tile] : homeCol[tile]) + 1 : 0);
+		}
+		return (*penalty)[code];
+	}
+};
+
+// Walking distance (Takahashi). Forgetting which column each tile is in, a board is just
+// how many of the tiles in each row belong in each row, and where the blank's row is.
+// Every vertical move takes a tile from a row next to the blank's into the blank's row,
+// so the fewest such moves from a board's counts to the goal's are a bound on the
+// vertical moves left. The same over columns bounds the horizontal moves, and since no
+// move is both the two add up. Each space is small (24964 states for the 15puzzle) and
+// is searched breadth first from the goal once, the distances kept by the packed counts.
+template <size_t N>
+class WalkingDistance {
+	// three bits for each count and the blank's line have to fit in a word
+	static_assert(N <= 4, "Walking distance is only tabled for boards of up to 4x4");
+
+public:
+	using Board = Puzzle<N>;
+	using PuzzleState = typename Board::PuzzleState;
+	using MOVE = typename Board::MOVE;
+
+	explicit WalkingDistance(const PuzzleState& goal)
+	: goal(goal), rows(std::make_shared<Axis>(goal, false)), columns(std::make_shared<Axis>(goal, true)) {}
+
+	const PuzzleState& Goal() const
+	{
+		return goal;
+	}
+
+	int Estimate(const PuzzleState& state) const
+	{
+		return rows->Distance(rows->Key(state)) + columns->Distance(columns->Key(state));
+	}
+
+	// a vertical move only changes the row counts and a horizontal one the column counts
+	int Update(int h, const PuzzleState& parent, MOVE m) const
+	{
+		const size_t blank = parent.Blank();
+		const size_t from = Board::Neighbours::cells[blank].target[m];
+		assert(from != Board::npos);
+		const Axis& axis = (from % N == blank % N) ? *rows : *columns;
+		const uint64_t key = axis.Key(parent);
+		return h - axis.Distance(key) + axis.Distance(axis.Move(key, parent, from));
+	}
+
+	int operator()(const PuzzleState& state, const PuzzleState& target, int cumulativeCost) const
+	{
+		// anything but our own goal gets the next best admissible estimate
+		if (!(target == goal)) {
+			return ManhattanDistance<N>(target)(state, target, cumulativeCost);
+		}
+		return Estimate(state) + cumulativeCost;
+	}
+
+private:
+	// the counts for rows, or for columns once transposed
+	class Axis {
+	public:
+		Axis(const PuzzleState& goal, bool transposed)
+		: transposed(transposed)
+		{
+			for (size_t tile = 1; tile < PuzzleState::size; ++tile)
+			{
+				home[tile] = static_cast<unsigned char>(Line(goal.Find(static_cast<char>(tile))));
+			}
+
+			// breadth first over the counts, moving the blank a line at a time
+			std::unordered_map<uint64_t, unsigned char> found;
+			std::vector<uint64_t> layer { Key(goal) }, next;
+			found.emplace(layer[0], 0);
+			for (unsigned char depth = 1; !layer.empty(); ++depth)
+			{
+				for (uint64_t key : layer)
+				{
+					const size_t blank = size_t(key >> blankShift);
+					for (size_t to : { blank - 1, blank + 1 })
+					{
+						if (to >= N) continue;
+						for (size_t line = 0; line < N; ++line)
+						{
+							if (!Count(key, to, line)) continue;
+							const uint64_t moved = Moved(key, to, blank, line);
+							if (found.emplace(moved, depth).second) {
+								next.push_back(moved);
+							}
+						}
+					}
+				}
+				layer.swap(next);
+				next.clear();
+			}
+
+			size_t capacity = 1;
+			while (capacity < 2 * found.size()) {
+				capacity *= 2;
+			}
+			keys.assign(capacity, 0);
+			distances.assign(capacity, 0);
+			for (const auto& entry : found)
+			{
+				size_t i = Slot(entry.first);
+				while (keys[i]) {
+					i = (i + 1) & (capacity - 1);
+				}
+				keys[i] = entry.first;
+				distances[i] = entry.second;
+			}
+		}
+
+		uint64_t Key(const PuzzleState& state) const
+		{
+			uint64_t key = 0;
+			for (size_t cell = 0; cell < PuzzleState::size; ++cell)
+			{
+				const auto tile = state.Get(cell);
+				if (tile) {
+					key += uint64_t(1) << Shift(Line(cell), home[size_t(tile)]);
+				}
+			}
+			return key | (uint64_t(Line(state.Blank())) << blankShift);
+		}
+
+		// the key after the tile at from slides into the blank
+		uint64_t Move(uint64_t key, const PuzzleState& parent, size_t from) const
+		{
+			return Moved(key, Line(from), Line(parent.Blank()), home[size_t(parent.Get(from))]);
+		}
+
+		int Distance(uint64_t key) const
+		{
+			// every key is nonzero since the tiles are counted somewhere, so 0 marks a free slot
+			for (size_t i = Slot(key); keys[i]; i = (i + 1) & (keys.size() - 1))
+			{
+				if (keys[i] == key) return distances[i];
+			}
+			// only a board that can't reach the goal has counts the search didn't
+			return 0;
+		}
+
+	private:
+		static constexpr size_t blankShift = 3 * N * N;
+
+		const bool transposed;
+		unsigned char home[PuzzleState::size] = {};
+		std::vector<uint64_t> keys;
+		std::vector<unsigned char> distances;
+
+		size_t Line(size_t cell) const
+		{
+			return (transposed) ? cell % N : cell / N;
+		}
+
+		static size_t Shift(size_t line, size_t home)
+		{
+			return 3 * (line * N + home);
+		}
+
+		static size_t Count(uint64_t key, size_t line, size_t home)
+		{
+			return size_t(key >> Shift(line, home)) & 7;
+		}
+
+		// a tile that belongs in line home goes from line from into the blank's line, to
+		static uint64_t Moved(uint64_t key, size_t from, size_t to, size_t home)
+		{
+			key = key - (uint64_t(1) << Shift(from, home)) + (uint64_t(1) << Shift(to, home));
+			return (key & ((uint64_t(1) << blankShift) - 1)) | (uint64_t(from) << blankShift);
+		}
+
+		size_t Slot(uint64_t key) const
+		{
+			return size_t(Mix(key)) & (keys.size() - 1);
+		}
+	};
+
+	PuzzleState goal;
+	// shared by the copies every CostCalc makes
+	std::shared_ptr<const Axis> rows;
+	std::shared_ptr<const Axis> columns;
+};
+
+// Adapts a heuristic's Update to a CostUpdate. stepCost is what each move adds on
+// top of the change in the estimate: 1 for A*, 0 for a greedy search.
+template <class Heuristic>
+typename Heuristic::Board::CostUpdate IncrementalCost(const Heuristic& heuristic, int stepCost = 1)
+{
+	using PuzzleState = typename Heuristic::PuzzleState;
+	using MOVE = typename Heuristic::MOVE;
+	return [heuristic, stepCost](int cost, const PuzzleState& parent, MOVE m) {
+		return heuristic.Update(cost + stepCost, parent, m);
+	};
+}
+
+#endif /* Heuristics_h */
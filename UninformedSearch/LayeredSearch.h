@@ -0,0 +1,487 @@
+#ifndef LayeredSearch_h
+#define LayeredSearch_h
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "MoveSequence.h"
+
+// Breadth first search with no closed list. Every state is packed into a word and each
+// layer is a sorted run of them. A child of layer d can only be in layer d - 1 or d + 1
+// (every move changes the parity of the blank's cell and of the permutation, so the
+// graph is bipartite and nothing is ever in its parent's layer), so only the previous,
+// current and next layers are kept. Children are deduplicated once the whole layer has
+// been generated: sorted, merged and with the previous layer taken out.
+//
+// Given a memory budget and a directory, children that don't fit the budget are sorted
+// and written out as runs which are merged into a next layer on disk (delayed duplicate
+// detection), so the space that can be searched is bounded by the disk rather than RAM.
+//
+// The shortest path comes from a bidirectional layered search: the first state the two
+// sides share is halfway along an optimal path, and the halves are solved the same way.
+template <class Board>
+class LayeredBreadthFirst {
+public:
+	using PuzzleState = typename Board::PuzzleState;
+	using MOVE = typename Board::MOVE;
+	using Key = uint64_t;
+	using LayerCallback = std::function<void(size_t depth, size_t states)>;
+
+	struct Result {
+		bool solved = false;
+		size_t depth = 0;
+		// states first reached at each depth; only filled in by Enumerate
+		std::vector<size_t> layers;
+		size_t expanded = 0;
+		size_t generated = 0;
+		size_t created = 0;
+		size_t peakLayer = 0;
+		// states held in the layers at once
+		size_t peakStates = 0;
+		// the most held in memory, and everything written out to disk
+		size_t bytes = 0;
+		size_t spilled = 0;
+		MoveSequence<MOVE> path;
+	};
+
+	// memory (bytes) only applies along with a directory to spill to; without one
+	// everything stays in memory
+	explicit LayeredBreadthFirst(size_t memory = 0, const std::string& directory = std::string())
+	: directory(directory),
+	  chunk((memory && !directory.empty()) ? std::max<size_t>(memory / (2 * sizeof(Key)), 1024) : 0) {}
+
+	// every state reachable from start; the radius of the space is the depth of the result
+	Result Enumerate(const PuzzleState& start, const LayerCallback& each = nullptr)
+	{
+		Result result;
+		Layer previous, current = Seed(start);
+		while (current.size()) {
+			result.layers.push_back(current.size());
+			result.created += current.size();
+			if (each) {
+				each(result.layers.size() - 1, current.size());
+			}
+			Layer next = Expand(previous, current, result);
+			Track(result, next.size(), previous.size() + current.size() + next.size());
+			previous = std::move(current);
+			current = std::move(next);
+		}
+		result.solved = true;
+		result.depth = result.layers.size() - 1;
+		return result;
+	}
+
+	Result Solve(const PuzzleState& start, const PuzzleState& goal)
+	{
+		Result result;
+		result.solved = Path(start, goal, result);
+		result.depth = result.path.size();
+		return result;
+	}
+
+private:
+	// a sorted run of distinct states, in memory or in a file of its own
+	struct Layer {
+		std::vector<Key> keys;
+		std::string file;
+		size_t count = 0;
+
+		Layer() = default;
+		Layer(const Layer&) = delete;
+		Layer& operator=(const Layer&) = delete;
+
+		Layer(Layer&& other)
+		{
+			*this = std::move(other);
+		}
+
+		Layer& operator=(Layer&& other)
+		{
+			if (this != &other) {
+				Drop();
+				keys = std::move(other.keys);
+				file = std::move(other.file);
+				count = other.count;
+				other.keys.clear();
+				other.file.clear();
+				other.count = 0;
+			}
+			return *this;
+		}
+
+		~Layer()
+		{
+			Drop();
+		}
+
+		size_t size() const
+		{
+			return count;
+		}
+
+		size_t bytes() const
+		{
+			return keys.capacity() * sizeof(Key);
+		}
+
+		void Drop()
+		{
+			if (!file.empty()) {
+				std::remove(file.c_str());
+			}
+			file.clear();
+			keys.clear();
+			count = 0;
+		}
+	};
+
+	static constexpr size_t block = size_t(1) << 15;
+
+	// reads a layer back in order, a block at a time when it is on disk
+	class Cursor {
+	public:
+		explicit Cursor(const Layer& layer)
+		{
+			if (layer.file.empty()) {
+				at = layer.keys.data();
+				end = at + layer.keys.size();
+				return;
+			}
+			in.open(layer.file, std::ios::binary);
+			if (!in) {
+				throw std::runtime_error("Could not read " + layer.file);
+			}
+			buffer.resize(block);
+			Refill();
+		}
+
+		bool Done() const
+		{
+			return at >= end;
+		}
+
+		Key Peek() const
+		{
+			return *at;
+		}
+
+		void Pop()
+		{
+			if (++at == end && in.is_open()) {
+				Refill();
+			}
+		}
+
+		// moves up to the first key not less than key; true if that is key itself
+		bool Seek(Key key)
+		{
+			while (!Done() && Peek() < key) {
+				Pop();
+			}
+			return !Done() && Peek() == key;
+		}
+
+	private:
+		std::ifstream in;
+		std::vector<Key> buffer;
+		const Key* at = nullptr;
+		const Key* end = nullptr;
+
+		void Refill()
+		{
+			in.read(reinterpret_cast<char*>(buffer.data()), block * sizeof(Key));
+			at = buffer.data();
+			end = at + size_t(in.gcount()) / sizeof(Key);
+		}
+	};
+
+	// fills a layer on disk in order
+	class Writer {
+	public:
+		explicit Writer(Layer& layer)
+		: layer(layer), out(layer.file, std::ios::binary)
+		{
+			if (!out) {
+				throw std::runtime_error("Could not write " + layer.file);
+			}
+			buffer.reserve(block);
+		}
+
+		void Push(Key key)
+		{
+			buffer.push_back(key);
+			++layer.count;
+			if (buffer.size() == block) {
+				Flush();
+			}
+		}
+
+		void Close()
+		{
+			Flush();
+			if (!out.flush()) {
+				throw std::runtime_error("Could not write " + layer.file);
+			}
+		}
+
+	private:
+		Layer& layer;
+		std::ofstream out;
+		std::vector<Key> buffer;
+
+		void Flush()
+		{
+			out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(Key));
+			buffer.clear();
+		}
+	};
+
+	const std::string directory;
+	// children buffered before they are written out as a run; 0 never writes any
+	const size_t chunk;
+	size_t files = 0;
+
+	static Layer Seed(const PuzzleState& state)
+	{
+		Layer layer;
+		layer.keys.push_back(state.Key());
+		layer.count = 1;
+		return layer;
+	}
+
+	static void Track(Result& result, size_t layer, size_t states)
+	{
+		result.peakLayer = std::max(result.peakLayer, layer);
+		result.peakStates = std::max(result.peakStates, states);
+	}
+
+	// Every run gets a file no one else has: the name takes in the process as well as the
+	// search, and is only used once it has been created here and found not to exist, so
+	// searches spilling to the same directory never write over each other's runs.
+	Layer NewFile()
+	{
+		Layer layer;
+		const std::string prefix = directory + "/layer-" + std::to_string(ProcessId()) + "-"
+								   + std::to_string(reinterpret_cast<uintptr_t>(this)) + "-";
+		do {
+			layer.file = prefix + std::to_string(files++) + ".run";
+		} while (!Claim(layer.file));
+		return layer;
+	}
+
+	static unsigned long ProcessId()
+	{
+#ifdef _WIN32
+		return static_cast<unsigned long>(_getpid());
+#else
+		return static_cast<unsigned long>(getpid());
+#endif
+	}
+
+	// creates path if it isn't there; false if it already was
+	static bool Claim(const std::string& path)
+	{
+#ifdef _WIN32
+		const int fd = _open(path.c_str(), _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY, _S_IREAD | _S_IWRITE);
+		if (fd < 0 && errno == EEXIST) return false;
+		if (fd >= 0) {
+			_close(fd);
+		}
+#else
+		const int fd = open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0600);
+		if (fd < 0 && errno == EEXIST) return false;
+		if (fd >= 0) {
+			close(fd);
+		}
+#endif
+		if (fd < 0) {
+			throw std::runtime_error("Could not write " + path);
+		}
+		return true;
+	}
+
+	Layer Spill(std::vector<Key>& children, Result& result)
+	{
+		std::sort(children.begin(), children.end());
+		children.erase(std::unique(children.begin(), children.end()), children.end());
+		Layer run = NewFile();
+		Writer out(run);
+		for (Key key : children)
+		{
+			out.Push(key);
+		}
+		out.Close();
+		result.spilled += run.size() * sizeof(Key);
+		children.clear();
+		return run;
+	}
+
+	// every child of current that isn't in previous
+	Layer Expand(const Layer& previous, const Layer& current, Result& result)
+	{
+		std::vector<Layer> runs;
+		std::vector<Key> children;
+		for (Cursor at(current); !at.Done(); at.Pop())
+		{
+			const PuzzleState state = PuzzleState::FromKey(at.Peek());
+			const auto& moves = Board::Neighbours::cells[state.Blank()];
+			for (size_t i = 0; i < moves.count; ++i)
+			{
+				PuzzleState child = state;
+				child.Slide(moves.target[moves.moves[i]]);
+				children.push_back(child.Key());
+			}
+			++result.expanded;
+			result.generated += moves.count;
+			if (chunk && children.size() >= chunk) {
+				result.bytes = std::max(result.bytes, previous.bytes() + current.bytes() + children.capacity() * sizeof(Key));
+				runs.push_back(Spill(children, result));
+			}
+		}
+		result.bytes = std::max(result.bytes, previous.bytes() + current.bytes() + children.capacity() * sizeof(Key));
+
+		Layer next;
+		if (runs.empty()) {
+			// it all fit so the layer is deduplicated where it lies
+			std::sort(children.begin(), children.end());
+			Cursor seen(previous);
+			Key last = 0;
+			size_t kept = 0;
+			for (Key key : children)
+			{
+				if ((kept && key == last) || seen.Seek(key)) continue;
+				children[kept++] = last = key;
+			}
+			children.resize(kept);
+			next.keys = std::move(children);
+			next.count = kept;
+			return next;
+		}
+
+		// the last state of the layer may have filled the buffer and spilled it already
+		if (!children.empty()) {
+			runs.push_back(Spill(children, result));
+		}
+		std::vector<std::unique_ptr<Cursor>> sources;
+		using Head = std::pair<Key, size_t>;
+		std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+		for (auto& run : runs)
+		{
+			sources.emplace_back(new Cursor(run));
+			if (!sources.back()->Done()) {
+				heads.push({ sources.back()->Peek(), sources.size() - 1 });
+			}
+		}
+
+		next = NewFile();
+		Writer out(next);
+		Cursor seen(previous);
+		bool any = false;
+		Key last = 0;
+		while (!heads.empty()) {
+			const Head head = heads.top();
+			heads.pop();
+			auto& source = *sources[head.second];
+			source.Pop();
+			if (!source.Done()) {
+				heads.push({ source.Peek(), head.second });
+			}
+			if ((any && head.first == last) || seen.Seek(head.first)) continue;
+			any = true;
+			last = head.first;
+			out.Push(head.first);
+		}
+		out.Close();
+		result.spilled += next.size() * sizeof(Key);
+		return next;
+	}
+
+	static bool Intersect(const Layer& a, const Layer& b, Key& found)
+	{
+		Cursor other(b);
+		for (Cursor at(a); !at.Done(); at.Pop())
+		{
+			if (other.Seek(at.Peek())) {
+				found = at.Peek();
+				return true;
+			}
+			if (other.Done()) break;
+		}
+		return false;
+	}
+
+	// Grows a layer from each end in turn. The depths add up to one more each turn and no
+	// layer can meet the other side until they add up to the distance, so the first state
+	// a new layer shares with the other side's newest is on a shortest path, halfway along.
+	bool Meet(const PuzzleState& a, const PuzzleState& b, PuzzleState& middle, Result& result)
+	{
+		struct Side {
+			Layer previous, current;
+		} sides[2];
+		sides[0].current = Seed(a);
+		sides[1].current = Seed(b);
+		for (size_t turn = 0;; turn ^= 1)
+		{
+			Side& side = sides[turn];
+			Side& other = sides[turn ^ 1];
+			Layer next = Expand(side.previous, side.current, result);
+			if (!next.size()) return false;
+			result.created += next.size();
+			Track(result, next.size(), side.previous.size() + side.current.size() + next.size() +
+				  other.previous.size() + other.current.size());
+
+			Key found;
+			if (Intersect(next, other.current, found)) {
+				middle = PuzzleState::FromKey(found);
+				return true;
+			}
+			side.previous = std::move(side.current);
+			side.current = std::move(next);
+		}
+	}
+
+	bool Path(const PuzzleState& a, const PuzzleState& b, Result& result)
+	{
+		if (a == b) return true;
+
+		// neighbours are joined directly so every split below has two shorter halves
+		const auto& moves = Board::Neighbours::cells[a.Blank()];
+		for (size_t i = 0; i < moves.count; ++i)
+		{
+			PuzzleState child = a;
+			child.Slide(moves.target[moves.moves[i]]);
+			if (child == b) {
+				result.path.push_back(static_cast<MOVE>(moves.moves[i]));
+				return true;
+			}
+		}
+
+		PuzzleState middle;
+		return Meet(a, b, middle, result) && Path(a, middle, result) && Path(middle, b, result);
+	}
+};
+
+template <class Board>
+constexpr size_t LayeredBreadthFirst<Board>::block;
+
+#endif /* LayeredSearch_h */
@@ -0,0 +1,101 @@
+#ifndef MappedFile_h
+#define MappedFile_h
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+// leaves out the old winsock, which can't be included along with Socket.h's
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A read only view of a whole file. The pages come straight from the page cache so
+// every process that maps the same file shares a single copy of it.
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("Could not open " + path);
+		}
+		LARGE_INTEGER length;
+		GetFileSizeEx(file, &length);
+		bytes = static_cast<size_t>(length.QuadPart);
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		view = (mapping) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (!view) {
+			Close();
+			throw std::runtime_error("Could not map " + path);
+		}
+#else
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("Could not open " + path);
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			close(fd);
+			throw std::runtime_error("Could not read " + path);
+		}
+		bytes = static_cast<size_t>(info.st_size);
+		view = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd); // the mapping keeps its own reference to the file
+		if (view == MAP_FAILED) {
+			view = nullptr;
+			throw std::runtime_error("Could not map " + path);
+		}
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	const unsigned char* data() const
+	{
+		return static_cast<const unsigned char*>(view);
+	}
+
+	size_t size() const
+	{
+		return bytes;
+	}
+
+private:
+	void* view = nullptr;
+	size_t bytes = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (view) UnmapViewOfFile(view);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+		mapping = nullptr;
+#else
+		if (view) munmap(view, bytes);
+#endif
+		view = nullptr;
+	}
+};
+
+#endif /* MappedFile_h */
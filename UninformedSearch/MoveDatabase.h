@@ -0,0 +1,239 @@
+#ifndef MoveDatabase_h
+#define MoveDatabase_h
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Puzzle.h"
+
+// Every answer to the 8puzzle, worked out ahead of time. One breadth first search back
+// from the goal reaches each solvable state along a shortest path, and the move that
+// path ends with, undone, is the first move of a shortest path from the state back to
+// the goal. The file holds that move for every permutation of the board in two bits,
+// indexed by the permutation's rank (9! states in 90KB), and is mapped rather than
+// read so solver processes share one copy of it.
+//
+// Solving is a walk: look up the move, make it, and repeat until the goal, so a
+// query costs one lookup a move and no search at all. The distance is the length of
+// the walk; storing it as well would take five bits a state and over twice the space.
+template <size_t N>
+class MoveDatabase {
+public:
+	using Board = Puzzle<N>;
+	using PuzzleState = typename Board::PuzzleState;
+	using MOVE = typename Board::MOVE;
+
+	static constexpr size_t size = PuzzleState::size;
+
+	// 4x4 has 16! states, which no file of two bits a state is going to hold
+	static_assert(size <= 9, "A move database is only practical for boards of up to 3x3");
+
+	explicit MoveDatabase(const std::string& path)
+	: file(std::make_shared<MappedFile>(path))
+	{
+		if (file->size() < sizeof(FileHeader)) {
+			throw std::runtime_error(path + " is not a move database");
+		}
+		FileHeader header;
+		std::memcpy(&header, file->data(), sizeof(header));
+		if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.n != N) {
+			throw std::runtime_error(path + " is not a move database for this size of puzzle");
+		}
+		if (sizeof(FileHeader) + TableBytes() > file->size()) {
+			throw std::runtime_error(path + " is truncated");
+		}
+		for (size_t i = 0; i < size; ++i)
+		{
+			goal.Set(i, header.goal[i]);
+		}
+		radius = header.radius;
+		table = file->data() + sizeof(FileHeader);
+	}
+
+	const PuzzleState& Goal() const
+	{
+		return goal;
+	}
+
+	// the move that starts a shortest path from state; state must be solvable and not the goal
+	MOVE Next(const PuzzleState& state) const
+	{
+		const uint64_t rank = Rank(state);
+		return static_cast<MOVE>(Board::UP + ((table[rank / 4] >> ((rank & 3) * 2)) & 3));
+	}
+
+	// a shortest path to the goal, walked off the table. stats report the moves as
+	// expanded, since each one is a state looked up
+	typename Board::Solution Solve(const PuzzleState& start) const
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		typename Board::Solution solution;
+		if (!start.Solvable(goal)) {
+			solution.stats.elapsed = std::chrono::steady_clock::now() - begin;
+			return solution;
+		}
+		PuzzleState state = start;
+		while (!(state == goal)) {
+			// a shortest path is never longer than the radius, so a walk that is has gone wrong
+			if (solution.path.size() == radius) {
+				throw std::runtime_error("The move database is corrupt");
+			}
+			const MOVE m = Next(state);
+			const size_t target = Board::Neighbours::cells[state.Blank()].target[m];
+			if (target == Board::npos) {
+				throw std::runtime_error("The move database is corrupt");
+			}
+			state.Slide(target);
+			solution.path.push_back(m);
+		}
+		solution.stats.solved = true;
+		solution.stats.expanded = solution.path.size();
+		solution.stats.depth = solution.path.size();
+		solution.stats.bytes = TableBytes();
+		solution.stats.elapsed = std::chrono::steady_clock::now() - begin;
+		return solution;
+	}
+
+	// Breadth first search back from goal over every state that can reach it, written to
+	// path. Gives the radius: the most moves any state needs.
+	static size_t Generate(const PuzzleState& goal, const std::string& path)
+	{
+		std::vector<unsigned char> moves(TableBytes(), 0);
+		std::vector<bool> seen(States(), false);
+		std::vector<uint64_t> layer(1, Rank(goal)), next;
+		seen[layer[0]] = true;
+		size_t depth = 0;
+
+		while (!layer.empty()) {
+			for (uint64_t rank : layer)
+			{
+				const PuzzleState state = Unrank(rank);
+				const auto& neighbours = Board::Neighbours::cells[state.Blank()];
+				for (size_t j = 0; j < neighbours.count; ++j)
+				{
+					const MOVE m = static_cast<MOVE>(neighbours.moves[j]);
+					PuzzleState child = state;
+					child.Slide(neighbours.target[m]);
+					const uint64_t childRank = Rank(child);
+					if (seen[childRank]) continue;
+					seen[childRank] = true;
+					// child got here by m, so m undone takes it a step closer to the goal
+					const unsigned back = static_cast<unsigned>(Board::Inverse(m) - Board::UP);
+					moves[childRank / 4] |= static_cast<unsigned char>(back << ((childRank & 3) * 2));
+					next.push_back(childRank);
+				}
+			}
+			layer.swap(next);
+			next.clear();
+			if (!layer.empty()) {
+				++depth;
+			}
+		}
+
+		FileHeader header = {};
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.n = N;
+		header.radius = static_cast<uint32_t>(depth);
+		for (size_t i = 0; i < size; ++i)
+		{
+			header.goal[i] = static_cast<unsigned char>(goal.Get(i));
+		}
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			throw std::runtime_error("Could not create " + path);
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(moves.data()), moves.size());
+		if (!out) {
+			throw std::runtime_error("Could not write " + path);
+		}
+		return depth;
+	}
+
+private:
+	// on disk layout; integers are stored in the byte order of the machine that built the file
+	static constexpr char magic[8] = { 'P', 'U', 'Z', 'M', 'D', 'B', '0', '1' };
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t n;
+		uint32_t radius;
+		unsigned char goal[32];
+	};
+
+	std::shared_ptr<const MappedFile> file;
+	PuzzleState goal;
+	const unsigned char* table = nullptr;
+	size_t radius = 0;
+
+	static uint64_t States()
+	{
+		uint64_t count = 1;
+		for (size_t i = 2; i <= size; ++i)
+		{
+			count *= i;
+		}
+		return count;
+	}
+
+	// four moves to a byte
+	static uint64_t TableBytes()
+	{
+		return (States() + 3) / 4;
+	}
+
+	// Lehmer code: each tile is numbered among the tiles not already placed before it
+	static uint64_t Rank(const PuzzleState& state)
+	{
+		uint64_t rank = 0;
+		unsigned used = 0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			const unsigned tile = static_cast<unsigned>(state.Get(i));
+			unsigned digit = tile;
+			for (unsigned t = 0; t < tile; ++t)
+			{
+				digit -= (used >> t) & 1;
+			}
+			used |= 1u << tile;
+			rank = rank * (size - i) + digit;
+		}
+		return rank;
+	}
+
+	static PuzzleState Unrank(uint64_t rank)
+	{
+		unsigned digits[size];
+		for (size_t i = size; i-- > 0;)
+		{
+			digits[i] = static_cast<unsigned>(rank % (size - i));
+			rank /= (size - i);
+		}
+		PuzzleState state;
+		unsigned used = 0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			unsigned tile = 0;
+			for (unsigned skip = digits[i]; (used >> tile) & 1 || skip; ++tile)
+			{
+				skip -= !((used >> tile) & 1);
+			}
+			used |= 1u << tile;
+			state.Set(i, static_cast<char>(tile));
+		}
+		return state;
+	}
+};
+
+template <size_t N>
+constexpr char MoveDatabase<N>::magic[8];
+
+#endif /* MoveDatabase_h */
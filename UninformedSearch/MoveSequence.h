@@ -0,0 +1,169 @@
+#ifndef MoveSequence_h
+#define MoveSequence_h
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+// A list of moves packed two bits apiece, 32 to a word. Move has to be an enum whose
+// four directions are numbered 1 through 4 (0 being "no move"), as Puzzle<N>::MOVE is.
+template <class Move>
+class MoveSequence {
+public:
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Move;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const Move*;
+		using reference = Move;
+
+		const_iterator(const MoveSequence& moves, size_t i)
+		: moves(&moves), i(i) {}
+
+		Move operator*() const
+		{
+			return (*moves)[i];
+		}
+
+		const_iterator& operator++()
+		{
+			++i;
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			const_iterator before = *this;
+			++i;
+			return before;
+		}
+
+		bool operator==(const const_iterator& rhs) const
+		{
+			return i == rhs.i && moves == rhs.moves;
+		}
+
+		bool operator!=(const const_iterator& rhs) const
+		{
+			return !(*this == rhs);
+		}
+
+	private:
+		const MoveSequence* moves;
+		size_t i;
+	};
+
+	void push_back(Move m)
+	{
+		assert(m >= 1 && m <= 4);
+		if (count % perWord == 0) {
+			words.push_back(0);
+		}
+		words.back() |= uint64_t(m - 1) << Shift(count);
+		++count;
+	}
+
+	void pop_back()
+	{
+		assert(count);
+		--count;
+		if (count % perWord == 0) {
+			words.pop_back();
+		} else {
+			words.back() &= ~(uint64_t(3) << Shift(count));
+		}
+	}
+
+	Move operator[](size_t i) const
+	{
+		assert(i < count);
+		return static_cast<Move>(((words[i / perWord] >> Shift(i)) & 3) + 1);
+	}
+
+	Move back() const
+	{
+		return (*this)[count - 1];
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	bool empty() const
+	{
+		return count == 0;
+	}
+
+	void clear()
+	{
+		words.clear();
+		count = 0;
+	}
+
+	void reserve(size_t moves)
+	{
+		words.reserve((moves + perWord - 1) / perWord);
+	}
+
+	void reverse()
+	{
+		if (count < 2) return;
+		for (size_t i = 0, j = count - 1; i < j; ++i, --j)
+		{
+			const Move a = (*this)[i], b = (*this)[j];
+			Set(i, b);
+			Set(j, a);
+		}
+	}
+
+	const_iterator begin() const
+	{
+		return const_iterator(*this, 0);
+	}
+
+	const_iterator end() const
+	{
+		return const_iterator(*this, count);
+	}
+
+	size_t bytes() const
+	{
+		return words.capacity() * sizeof(uint64_t);
+	}
+
+	bool operator==(const MoveSequence& rhs) const
+	{
+		return count == rhs.count && words == rhs.words;
+	}
+
+	bool operator!=(const MoveSequence& rhs) const
+	{
+		return !(*this == rhs);
+	}
+
+private:
+	static constexpr size_t perWord = 32;
+
+	std::vector<uint64_t> words;
+	size_t count = 0;
+
+	static unsigned Shift(size_t i)
+	{
+		return unsigned(i % perWord) * 2;
+	}
+
+	void Set(size_t i, Move m)
+	{
+		auto& word = words[i / perWord];
+		word = (word & ~(uint64_t(3) << Shift(i))) | (uint64_t(m - 1) << Shift(i));
+	}
+};
+
+template <class Move>
+constexpr size_t MoveSequence<Move>::perWord;
+
+#endif /* MoveSequence_h */
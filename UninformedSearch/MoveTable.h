@@ -0,0 +1,77 @@
+#ifndef MoveTable_h
+#define MoveTable_h
+
+#include <cstddef>
+#include <utility>
+
+// Where the blank can go from every cell of an N x N board, worked out by the compiler.
+// Moves are numbered as Puzzle<N>::MOVE numbers them: 1 up, 2 down, 3 left, 4 right.
+// Everything is written as C++11 single expression constexpr so VS2015 can build it.
+namespace MoveTableDetail {
+	constexpr size_t Target(size_t n, size_t blank, unsigned char m)
+	{
+		return (m == 1) ? ((blank >= n) ? blank - n : n*n) :
+			   (m == 2) ? ((blank + n < n*n) ? blank + n : n*n) :
+			   (m == 3) ? ((blank % n != 0) ? blank - 1 : n*n) :
+			   (m == 4) ? ((blank % n != n - 1) ? blank + 1 : n*n) :
+			   n*n;
+	}
+
+	// children are made counterclockwise: up, left, down then right
+	constexpr unsigned char Order(size_t i)
+	{
+		return (i == 0) ? 1 : (i == 1) ? 3 : (i == 2) ? 2 : 4;
+	}
+
+	// the kth move, in Order, that stays on the board; 0 when there are fewer than k + 1
+	constexpr unsigned char NthMove(size_t n, size_t blank, size_t k, size_t i = 0)
+	{
+		return (i == 4) ? 0 :
+			   (Target(n, blank, Order(i)) == n*n) ? NthMove(n, blank, k, i + 1) :
+			   (k == 0) ? Order(i) : NthMove(n, blank, k - 1, i + 1);
+	}
+
+	constexpr unsigned char Count(size_t n, size_t blank)
+	{
+		return static_cast<unsigned char>((NthMove(n, blank, 0) != 0) + (NthMove(n, blank, 1) != 0) +
+										  (NthMove(n, blank, 2) != 0) + (NthMove(n, blank, 3) != 0));
+	}
+}
+
+template <size_t N, class Cells = std::make_index_sequence<N*N>>
+struct MoveTable;
+
+template <size_t N, size_t... cell>
+struct MoveTable<N, std::index_sequence<cell...>> {
+	// target of a move that would leave the board
+	static constexpr unsigned char none = N*N;
+
+	struct Cell {
+		// the legal moves in the order children are made
+		unsigned char count;
+		unsigned char moves[4];
+		// the cell the blank swaps with, by move; none for off the board (and for move 0)
+		unsigned char target[5];
+	};
+
+	static constexpr Cell cells[N*N] = {
+		{
+			MoveTableDetail::Count(N, cell),
+			{ MoveTableDetail::NthMove(N, cell, 0), MoveTableDetail::NthMove(N, cell, 1),
+			  MoveTableDetail::NthMove(N, cell, 2), MoveTableDetail::NthMove(N, cell, 3) },
+			{ none,
+			  static_cast<unsigned char>(MoveTableDetail::Target(N, cell, 1)),
+			  static_cast<unsigned char>(MoveTableDetail::Target(N, cell, 2)),
+			  static_cast<unsigned char>(MoveTableDetail::Target(N, cell, 3)),
+			  static_cast<unsigned char>(MoveTableDetail::Target(N, cell, 4)) }
+		}...
+	};
+};
+
+template <size_t N, size_t... cell>
+constexpr unsigned char MoveTable<N, std::index_sequence<cell...>>::none;
+
+template <size_t N, size_t... cell>
+constexpr typename MoveTable<N, std::index_sequence<cell...>>::Cell MoveTable<N, std::index_sequence<cell...>>::cells[N*N];
+
+#endif /* MoveTable_h */
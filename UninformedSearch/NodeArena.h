@@ -0,0 +1,86 @@
+#ifndef NodeArena_h
+#define NodeArena_h
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "PageMemory.h"
+
+// the fewest nodes of bytes each, a power of two no lower than least, that fill a whole
+// number of huge pages
+constexpr size_t ArenaBlockSize(size_t bytes, size_t least)
+{
+	return (least * bytes % PageMemory::huge == 0) ? least : ArenaBlockSize(bytes, least * 2);
+}
+
+// Owns every node a search creates. Nodes are handed out from fixed size blocks
+// so growing the arena never moves an existing node, and they are all released
+// together when the arena goes out of scope. A block is a whole number of huge pages,
+// so it can be mapped in them with nothing left over (see PageMemory.h). Nodes are
+// made as they are handed out, so the only pages of a block a search touches are the
+// ones its nodes are on.
+template <class Node>
+class NodeArena {
+public:
+	using Index = uint32_t;
+
+	static constexpr size_t blockSize = ArenaBlockSize(sizeof(Node), size_t(1) << 16);
+
+	// blocks are handed back without running any destructors
+	static_assert(std::is_trivially_destructible<Node>::value, "arena nodes must be plain data");
+
+	Index Allocate(const Node& node)
+	{
+		if (count % blockSize == 0 && count / blockSize == blocks.size()) {
+			blocks.push_back(Block(Allocator().allocate(blockSize)));
+		}
+		assert(count < Index(-1)); // the last index is reserved for "no node"
+		const auto index = static_cast<Index>(count++);
+		new (&(*this)[index]) Node(node);
+		return index;
+	}
+
+	Node& operator[](Index i)
+	{
+		assert(i < count);
+		return blocks[i / blockSize][i % blockSize];
+	}
+
+	const Node& operator[](Index i) const
+	{
+		assert(i < count);
+		return blocks[i / blockSize][i % blockSize];
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	// what the nodes handed out take up; the rest of the last block is never touched
+	size_t bytes() const
+	{
+		return count * sizeof(Node);
+	}
+
+private:
+	using Allocator = PageAllocator<Node>;
+
+	struct Release {
+		void operator()(Node* block) const
+		{
+			Allocator().deallocate(block, blockSize);
+		}
+	};
+
+	using Block = std::unique_ptr<Node[], Release>;
+
+	std::vector<Block> blocks;
+	size_t count = 0;
+};
+
+#endif /* NodeArena_h */
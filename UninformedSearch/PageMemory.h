@@ -0,0 +1,394 @@
+#ifndef PageMemory_h
+#define PageMemory_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <new>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#pragma comment(lib, "advapi32.lib")
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/mman.h>
+#else
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Where the big tables of a search get their memory. A large search spends its time
+// reaching into explored tables and node arenas far bigger than the TLB can cover in
+// 4KB pages, so each of those misses costs a page walk on top of the cache miss. Mapped
+// in 2MB (huge) or 1GB (gigantic) pages one TLB entry covers hundreds or hundreds of
+// thousands of times as much.
+//
+// Huge pages are what the configuration asks for, not what it gets: the system has to
+// have them set aside (vm.nr_hugepages on linux, the lock pages in memory right on
+// windows) and a mapping has to be a whole number of them. Anything that can't have
+// them gets normal pages instead, with transparent huge pages asked for on linux, so
+// asking is never an error. Mapped() says how much got each.
+//
+// With numa on, the hash distributed search keeps each thread on a node of its own and
+// maps what that thread owns from the node's memory (see Placement), so each lookup is
+// local. Without it everything comes from wherever the system puts it.
+//
+// Configure before searching: memory is handed back the way the configuration says it
+// was got, so it mustn't change while anything is allocated.
+class PageMemory {
+public:
+	enum PageSize { NORMAL_PAGES, HUGE_PAGES, GIGANTIC_PAGES };
+
+	static constexpr size_t huge = size_t(1) << 21;
+	static constexpr size_t gigantic = size_t(1) << 30;
+
+	struct Settings {
+		PageSize pages = NORMAL_PAGES;
+		bool numa = false;
+	};
+
+	static void Configure(const Settings& settings)
+	{
+		Configuration() = settings;
+#ifdef _WIN32
+		if (settings.pages != NORMAL_PAGES) {
+			LockPages();
+		}
+#endif
+	}
+
+	static const Settings& Current()
+	{
+		return Configuration();
+	}
+
+	// true if a block of bytes is worth mapping in its own pages: with normal pages the
+	// heap already does as well, and reuses what a search gave back without faulting it
+	// in again
+	static bool Maps(size_t bytes)
+	{
+		return bytes >= huge && Configuration().pages != NORMAL_PAGES;
+	}
+
+	// bytes mapped so far with pages of each size
+	static size_t Mapped(PageSize pages)
+	{
+		return Counter(pages).load(std::memory_order_relaxed);
+	}
+
+	// zeroed memory straight from the system, in the largest pages that can be had for it
+	static void* Map(size_t bytes)
+	{
+		const Settings& settings = Configuration();
+		bytes = Length(bytes);
+		void* memory = nullptr;
+		PageSize got = NORMAL_PAGES;
+#ifdef _WIN32
+		const SIZE_T large = (settings.pages != NORMAL_PAGES && LockPages()) ? GetLargePageMinimum() : 0;
+		if (large && bytes % large == 0) {
+			memory = Allocate(bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES);
+			got = HUGE_PAGES;
+		}
+		if (!memory) {
+			memory = Allocate(bytes, MEM_RESERVE | MEM_COMMIT);
+			got = NORMAL_PAGES;
+		}
+#elif defined(__APPLE__)
+		(void)settings;
+		memory = Anonymous(bytes, 0);
+#else
+		if (settings.pages == GIGANTIC_PAGES && bytes % gigantic == 0) {
+			memory = Anonymous(bytes, MAP_HUGETLB | (30 << hugeShift));
+			got = GIGANTIC_PAGES;
+		}
+		if (!memory && settings.pages != NORMAL_PAGES && bytes % huge == 0) {
+			memory = Anonymous(bytes, MAP_HUGETLB);
+			got = HUGE_PAGES;
+		}
+		if (!memory) {
+			memory = Anonymous(bytes, 0);
+			got = NORMAL_PAGES;
+#ifdef MADV_HUGEPAGE
+			// counted as normal since whether the kernel gives any is its own business
+			if (memory && settings.pages != NORMAL_PAGES) {
+				madvise(memory, bytes, MADV_HUGEPAGE);
+			}
+#endif
+		}
+		if (memory && settings.numa && Node() >= 0) {
+			// preferred rather than bound so a full node spills over instead of failing
+			const int preferred = 1;
+			unsigned long mask = 1ul << Node();
+			syscall(SYS_mbind, memory, bytes, preferred, &mask, sizeof(mask) * 8, 0);
+		}
+#endif
+		if (!memory) {
+			throw std::bad_alloc();
+		}
+		Counter(got).fetch_add(bytes, std::memory_order_relaxed);
+		return memory;
+	}
+
+	// bytes is what was given to Map
+	static void Unmap(void* memory, size_t bytes)
+	{
+#ifdef _WIN32
+		(void)bytes;
+		VirtualFree(memory, 0, MEM_RELEASE);
+#else
+		munmap(memory, Length(bytes));
+#endif
+	}
+
+	// NUMA nodes on the machine, 1 where there is no telling
+	static size_t Nodes()
+	{
+		static const size_t nodes = CountNodes();
+		return nodes;
+	}
+
+	// While one of these lives, what the calling thread maps comes from node
+	// index % Nodes(). Nothing changes unless numa is configured and there is more than
+	// one node.
+	class Placement {
+	public:
+		explicit Placement(size_t index)
+		: previous(Node())
+		{
+			if (Configuration().numa && Nodes() > 1) {
+				Node() = static_cast<int>(index % Nodes());
+			}
+		}
+
+		Placement(const Placement&) = delete;
+		Placement& operator=(const Placement&) = delete;
+
+		~Placement()
+		{
+			Node() = previous;
+		}
+
+	private:
+		const int previous;
+	};
+
+	// keeps the calling thread on the cpus of node index % Nodes() for the rest of its
+	// life, on the same terms as Placement
+	static void Pin(size_t index)
+	{
+		if (!Configuration().numa || Nodes() <= 1) return;
+		const size_t node = index % Nodes();
+#ifdef _WIN32
+		ULONGLONG mask = 0;
+		if (GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask) && mask) {
+			SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(mask));
+		}
+#elif !defined(__APPLE__)
+		std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		std::string list;
+		if (!std::getline(in, list)) return;
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		// ranges like 0-15,32-47
+		for (size_t at = 0; at < list.size();)
+		{
+			unsigned first = 0, last = 0;
+			int used = 0;
+			if (std::sscanf(list.c_str() + at, "%u-%u%n", &first, &last, &used) != 2) {
+				if (std::sscanf(list.c_str() + at, "%u%n", &first, &used) != 1) break;
+				last = first;
+			}
+			for (unsigned cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+			{
+				CPU_SET(cpu, &cpus);
+			}
+			at += used + 1;
+		}
+		if (CPU_COUNT(&cpus)) {
+			sched_setaffinity(0, sizeof(cpus), &cpus);
+		}
+#endif
+	}
+
+	// what the process holds in memory right now
+	static size_t Resident()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return counters.WorkingSetSize;
+		}
+		return 0;
+#elif defined(__APPLE__)
+		mach_task_basic_info_data_t info;
+		mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+		if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+			return 0;
+		}
+		return static_cast<size_t>(info.resident_size);
+#else
+		// in pages: the whole mapping, then what of it is resident
+		std::ifstream in("/proc/self/statm");
+		size_t total = 0, resident = 0;
+		if (!(in >> total >> resident)) {
+			return 0;
+		}
+		return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	}
+
+private:
+#if !defined(_WIN32) && !defined(__APPLE__)
+	// where mmap takes the log of the page size it is asked for
+#ifdef MAP_HUGE_SHIFT
+	static constexpr int hugeShift = MAP_HUGE_SHIFT;
+#else
+	static constexpr int hugeShift = 26;
+#endif
+#endif
+
+	static Settings& Configuration()
+	{
+		static Settings settings;
+		return settings;
+	}
+
+	// What a mapping of bytes really takes. With large pages asked for, anything of a huge
+	// page or more is rounded up to whole ones, which is all they can be mapped in; the
+	// rest of the last one is wasted, so what is mapped often should be sized to fit.
+	static size_t Length(size_t bytes)
+	{
+		if (Configuration().pages == NORMAL_PAGES || bytes < huge) return bytes;
+		return (bytes + huge - 1) / huge * huge;
+	}
+
+	static std::atomic<size_t>& Counter(PageSize pages)
+	{
+		static std::atomic<size_t> counters[3];
+		return counters[pages];
+	}
+
+	// the node the calling thread maps from, -1 for wherever the system likes
+	static int& Node()
+	{
+		static thread_local int node = -1;
+		return node;
+	}
+
+#ifdef _WIN32
+	// Having the lock pages in memory right isn't enough: it starts out switched off in
+	// the process's token, and every large page allocation fails until it is switched on.
+	// That is tried once; without the right the large pages are never asked for, and
+	// everything is counted as normal pages, much as on linux without any set aside.
+	static bool LockPages()
+	{
+		static const bool locked = [] {
+			HANDLE token = nullptr;
+			if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+			TOKEN_PRIVILEGES privileges = {};
+			privileges.PrivilegeCount = 1;
+			privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+			// AdjustTokenPrivileges succeeds even when the right isn't held, and says so after
+			const bool enabled = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+							  && AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+							  && GetLastError() == ERROR_SUCCESS;
+			CloseHandle(token);
+			return enabled;
+		}();
+		return locked;
+	}
+
+	static void* Allocate(size_t bytes, DWORD type)
+	{
+		if (Configuration().numa && Node() >= 0) {
+			return VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, type, PAGE_READWRITE, static_cast<DWORD>(Node()));
+		}
+		return VirtualAlloc(nullptr, bytes, type, PAGE_READWRITE);
+	}
+
+	static size_t CountNodes()
+	{
+		ULONG highest = 0;
+		return GetNumaHighestNodeNumber(&highest) ? highest + 1 : 1;
+	}
+#else
+	static void* Anonymous(size_t bytes, int flags)
+	{
+		void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+		return (memory == MAP_FAILED) ? nullptr : memory;
+	}
+
+	static size_t CountNodes()
+	{
+#ifdef __APPLE__
+		return 1;
+#else
+		// the last node in a list like 0-3 or 0,2
+		std::ifstream in("/sys/devices/system/node/online");
+		std::string list;
+		if (!std::getline(in, list) || list.empty()) return 1;
+		const size_t last = list.find_last_of(",-");
+		const size_t highest = std::stoul(list.substr((last == std::string::npos) ? 0 : last + 1));
+		// past the mask mbind is given here nothing could be placed anyway
+		return std::min<size_t>(highest + 1, sizeof(unsigned long) * 8);
+#endif
+	}
+#endif
+};
+
+// A standard allocator over PageMemory for the containers that grow large. With large
+// pages configured anything of a huge page or more is mapped; everything else comes
+// from operator new.
+template <class T>
+class PageAllocator {
+public:
+	using value_type = T;
+
+	PageAllocator() = default;
+
+	template <class U>
+	PageAllocator(const PageAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		const size_t bytes = n * sizeof(T);
+		if (PageMemory::Maps(bytes)) {
+			return static_cast<T*>(PageMemory::Map(bytes));
+		}
+		return static_cast<T*>(::operator new(bytes));
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		const size_t bytes = n * sizeof(T);
+		if (PageMemory::Maps(bytes)) {
+			PageMemory::Unmap(p, bytes);
+		} else {
+			::operator delete(p);
+		}
+	}
+
+	template <class U>
+	bool operator==(const PageAllocator<U>&) const
+	{
+		return true;
+	}
+
+	template <class U>
+	bool operator!=(const PageAllocator<U>&) const
+	{
+		return false;
+	}
+};
+
+#endif /* PageMemory_h */
@@ -0,0 +1,420 @@
+#ifndef ParallelSearch_h
+#define ParallelSearch_h
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Frontier.h"
+#include "MoveSequence.h"
+#include "NodeArena.h"
+#include "PageMemory.h"
+#include "StateTable.h"
+
+// Many producers, one consumer, no locks (Vyukov). Producers swap themselves in as
+// the new head; the consumer follows next pointers from the tail. A stub node is
+// always present so neither side ever sees the queue truly empty.
+template <class T>
+class MpscQueue {
+public:
+	MpscQueue()
+	: head(new Node), tail(head.load()) {}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	~MpscQueue()
+	{
+		T discard;
+		while (Pop(discard)) {}
+		delete tail;
+	}
+
+	void Push(T value)
+	{
+		Node* node = new Node;
+		node->value = std::move(value);
+		Node* previous = head.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	// only ever called by the owning thread
+	bool Pop(T& value)
+	{
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if (!next) {
+			return false;
+		}
+		value = std::move(next->value);
+		delete tail;
+		tail = next;
+		return true;
+	}
+
+private:
+	struct Node {
+		std::atomic<Node*> next{nullptr};
+		T value;
+	};
+
+	std::atomic<Node*> head;
+	Node* tail;
+};
+
+// Hash distributed A* (Kishimoto, Fukunaga & Botea). Every state has an owning thread
+// picked by its hash, and only the owner keeps it in an open list or closed table,
+// so threads never share search data. Children whose owner is another thread are
+// batched and posted to that thread's queue.
+//
+// A thread with nothing cheaper than the best solution so far is idle. The search
+// ends when every thread is idle and no batch is in flight. Both are counted in a
+// single atomic, so the count can only reach zero once the work is really done and
+// can never rise again after that. At that point every open node costs at least the
+// incumbent, which makes the incumbent optimal for an admissible heuristic.
+//
+// Cost puts a cost on each node, as Board's FunctionCost and HeuristicCost do.
+template <class Board, class Cost = typename Board::FunctionCost>
+class HashDistributedAStar {
+public:
+	using PuzzleState = typename Board::PuzzleState;
+	using MOVE = typename Board::MOVE;
+
+	struct Result {
+		bool solved = false;
+		size_t cost = 0;
+		// the cheapest node left unexpanded anywhere when the search stopped, pruned ones
+		// included; the solution is optimal only if it costs no more than this
+		size_t lowerBound = 0;
+		size_t expanded = 0;
+		size_t generated = 0;
+		size_t duplicates = 0;
+		size_t created = 0;
+		// summed over the threads, each at its own peak
+		size_t peakFrontier = 0;
+		size_t peakExplored = 0;
+		size_t bytes = 0;
+		// the process's, taken before the threads let go of their memory
+		size_t resident = 0;
+		MoveSequence<MOVE> path;
+	};
+
+	HashDistributedAStar(const PuzzleState& goal, const Cost& cost, size_t threads)
+	: goal(goal), cost(cost), workers(std::max<size_t>(threads, 1)) {}
+
+	Result Solve(const PuzzleState& start)
+	{
+		std::vector<std::unique_ptr<Worker>> team;
+		for (size_t i = 0; i < workers; ++i)
+		{
+			// each thread's tables come from its own node when numa is on (see PageMemory.h)
+			PageMemory::Placement place(i);
+			team.emplace_back(new Worker(*this, i));
+		}
+		crew = &team;
+		incumbent = unsolved;
+		best = none;
+		active = workers;
+
+		Message root { start, none, 0, static_cast<uint32_t>(cost.Root(start)), Board::NONE };
+		team[Owner(start)]->Receive(root);
+
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < workers; ++i)
+		{
+			threads.emplace_back([&team, i] {
+				PageMemory::Pin(i);
+				PageMemory::Placement place(i);
+				team[i]->Run();
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		Result result;
+		result.resident = PageMemory::Resident();
+		result.lowerBound = std::numeric_limits<size_t>::max();
+		for (auto& worker : team)
+		{
+			result.expanded += worker->expanded;
+			result.generated += worker->generated;
+			result.duplicates += worker->duplicates;
+			result.created += worker->created;
+			result.peakFrontier += worker->peakOpen;
+			result.peakExplored += worker->closed.size();
+			result.bytes += worker->nodes.bytes() + worker->closed.bytes() + worker->peakOpen * sizeof(Entry);
+			result.lowerBound = std::min(result.lowerBound, worker->LowestLeft());
+		}
+
+		result.solved = incumbent != unsolved;
+		if (result.solved) {
+			result.cost = incumbent;
+			for (uint64_t ref = best; ref != none;)
+			{
+				const Node& node = team[ref >> shift]->nodes[static_cast<NodeIndex>(ref & mask)];
+				if (node.parent == none) break;
+				result.path.push_back(node.action);
+				ref = node.parent;
+			}
+			result.path.reverse();
+			assert(result.path.size() == result.cost);
+		}
+		return result;
+	}
+
+private:
+	using NodeIndex = uint32_t;
+
+	// a node anywhere in the search: the owning thread in the top byte, its index below
+	static constexpr unsigned shift = 56;
+	static constexpr uint64_t mask = (uint64_t(1) << shift) - 1;
+	static constexpr uint64_t none = uint64_t(-1);
+	static constexpr size_t unsolved = std::numeric_limits<size_t>::max();
+	static constexpr size_t batchSize = 64;
+
+	struct Node {
+		PuzzleState state;
+		uint64_t parent;
+		uint32_t g;
+		uint32_t cost;
+		MOVE action;
+	};
+
+	// a child on its way to its owner
+	struct Message {
+		PuzzleState state;
+		uint64_t parent;
+		uint32_t g;
+		uint32_t cost;
+		MOVE action;
+	};
+
+	struct Entry {
+		NodeIndex node;
+		uint32_t cost;
+		uint32_t g;
+	};
+
+	using Batch = std::vector<Message>;
+
+	struct Worker {
+		HashDistributedAStar& search;
+		const size_t id;
+		NodeArena<Node> nodes;
+		HashedStateTable<PuzzleState, NodeIndex> closed;
+		BucketQueue<Entry> open;
+		MpscQueue<Batch> inbox;
+		std::vector<Batch> outbox;
+		bool busy = true;
+		size_t expanded = 0;
+		size_t generated = 0;
+		size_t duplicates = 0;
+		size_t created = 0;
+		size_t peakOpen = 0;
+		// the cheapest node dropped for costing no less than the incumbent of the time
+		size_t pruned = std::numeric_limits<size_t>::max();
+
+		Worker(HashDistributedAStar& search, size_t id)
+		: search(search), id(id), closed(1 << 16, NodeIndex(-1)), outbox(search.workers) {}
+
+		// a duplicate only replaces what we have if it got here in fewer moves
+		void Receive(const Message& message)
+		{
+			if (message.cost >= search.incumbent.load(std::memory_order_relaxed)) {
+				pruned = std::min<size_t>(pruned, message.cost);
+				return;
+			}
+
+			auto found = closed.Find(message.state);
+			if (found) {
+				Node& existing = nodes[*found];
+				if (existing.g <= message.g) {
+					++duplicates;
+					return;
+				}
+				existing = Node{ message.state, message.parent, message.g, message.cost, message.action };
+				open.push({ *found, message.cost, message.g });
+				return;
+			}
+			const auto index = nodes.Allocate(Node{ message.state, message.parent, message.g, message.cost, message.action });
+			closed.Insert(message.state, index);
+			open.push({ index, message.cost, message.g });
+			peakOpen = std::max(peakOpen, open.size());
+			++created;
+		}
+
+		// drop entries made stale by a cheaper duplicate or a better incumbent
+		bool Useful()
+		{
+			while (!open.empty()) {
+				const Entry& top = open.top();
+				if (nodes[top.node].g == top.g) {
+					if (top.cost < search.incumbent.load(std::memory_order_relaxed)) {
+						return true;
+					}
+					pruned = std::min<size_t>(pruned, top.cost);
+				}
+				open.pop();
+			}
+			return false;
+		}
+
+		// The cheapest node this thread never expanded, open, pruned or still on its way
+		// in, whatever the incumbent is now. Once the search is over nothing it gives can
+		// be under the solution unless the search stopped early or pruned too much.
+		size_t LowestLeft()
+		{
+			size_t lowest = pruned;
+			while (!open.empty() && nodes[open.top().node].g != open.top().g) {
+				open.pop();
+			}
+			if (!open.empty()) {
+				lowest = std::min<size_t>(lowest, open.top().cost);
+			}
+			Batch batch;
+			while (inbox.Pop(batch)) {
+				for (const auto& message : batch)
+				{
+					lowest = std::min<size_t>(lowest, message.cost);
+				}
+			}
+			for (const auto& pending : outbox)
+			{
+				for (const auto& message : pending)
+				{
+					lowest = std::min<size_t>(lowest, message.cost);
+				}
+			}
+			return lowest;
+		}
+
+		void Expand()
+		{
+			const Entry entry = open.top();
+			open.pop();
+			const Node node = nodes[entry.node];
+			const uint64_t self = (uint64_t(id) << shift) | entry.node;
+
+			// the goal has exactly one owner so only this thread ever writes the incumbent
+			if (node.state == search.goal) {
+				if (node.g < search.incumbent.load(std::memory_order_relaxed)) {
+					search.best = self;
+					search.incumbent.store(node.g);
+				}
+				return;
+			}
+
+			++expanded;
+			const auto& moves = Board::Neighbours::cells[node.state.Blank()];
+			for (size_t i = 0; i < moves.count; ++i)
+			{
+				const MOVE m = static_cast<MOVE>(moves.moves[i]);
+				if (m == Board::Inverse(node.action)) continue;
+				const size_t target = moves.target[m];
+
+				++generated;
+				Message child { node.state, self, node.g + 1, 0, m };
+				child.state.Slide(target);
+				child.cost = static_cast<uint32_t>((search.cost.Incremental()) ? search.cost.Update(int(node.cost), node.state, m)
+													: search.cost.Score(child.state, int(child.g)));
+
+				const size_t owner = search.Owner(child.state);
+				if (owner == id) {
+					Receive(child);
+				} else {
+					outbox[owner].push_back(child);
+					if (outbox[owner].size() >= batchSize) {
+						Send(owner);
+					}
+				}
+			}
+		}
+
+		void Send(size_t owner)
+		{
+			if (outbox[owner].empty()) return;
+			// count the batch before anyone can see it so the total never dips to zero early
+			search.active.fetch_add(1);
+			(*search.crew)[owner]->inbox.Push(std::move(outbox[owner]));
+			outbox[owner] = Batch();
+			outbox[owner].reserve(batchSize);
+		}
+
+		bool Drain()
+		{
+			bool received = false;
+			Batch batch;
+			while (inbox.Pop(batch)) {
+				if (!busy) {
+					busy = true;
+					search.active.fetch_add(1);
+				}
+				for (const auto& message : batch)
+				{
+					Receive(message);
+				}
+				search.active.fetch_sub(1);
+				received = true;
+			}
+			return received;
+		}
+
+		void Run()
+		{
+			for (;;) {
+				Drain();
+				const bool working = Useful();
+				// a handful of expansions between checks of the inbox
+				for (int i = 0; i < 32 && Useful(); ++i)
+				{
+					Expand();
+				}
+
+				// partial batches go out too: a cheap child held back here lets the
+				// other threads wander off into nodes that an optimal search never opens
+				for (size_t owner = 0; owner < outbox.size(); ++owner)
+				{
+					Send(owner);
+				}
+				if (working) {
+					// give the others their turn when there are more of us than cores
+					std::this_thread::yield();
+					continue;
+				}
+				if (Drain()) continue;
+
+				if (busy) {
+					busy = false;
+					search.active.fetch_sub(1);
+				}
+				if (search.active.load() == 0) {
+					return;
+				}
+				std::this_thread::yield();
+			}
+		}
+	};
+
+	const PuzzleState goal;
+	const Cost& cost;
+	const size_t workers;
+	std::vector<std::unique_ptr<Worker>>* crew = nullptr;
+	std::atomic<size_t> incumbent{unsolved};
+	uint64_t best = none; // only read once the workers have joined
+	// busy workers plus batches that have been sent but not yet taken in
+	std::atomic<size_t> active{0};
+
+	size_t Owner(const PuzzleState& state) const
+	{
+		// the tables index with the low bits of the hash so pick owners with the high ones
+		return static_cast<size_t>((uint64_t(state.hash()) * 0x9E3779B97F4A7C15ull) >> 40) % workers;
+	}
+};
+
+#endif /* ParallelSearch_h */
@@ -0,0 +1,439 @@
+#ifndef PatternDatabase_h
+#define PatternDatabase_h
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Heuristics.h"
+#include "MappedFile.h"
+#include "Puzzle.h"
+
+// Additive pattern databases (Korf & Felner). The tiles are split into disjoint
+// groups and, for every placement of a group's tiles, the table holds the fewest
+// moves *of those tiles* needed to bring them all home. Since no move is counted
+// by two groups the values can be summed and the total is still admissible.
+//
+// The tables are built offline by Generate and written to a single file. At startup
+// the file is mapped rather than read so solver processes share one copy of it.
+//
+// A group's value is never less than the Manhattan distance of its tiles and has
+// the same parity, so the table stores (value - manhattan) / 2 in a nibble and the
+// Manhattan part is added back from a small table at lookup.
+template <size_t N>
+class PatternDatabase {
+public:
+	using Board = Puzzle<N>;
+	using PuzzleState = typename Board::PuzzleState;
+	using MOVE = typename Board::MOVE;
+	using Group = std::vector<char>;
+
+	static constexpr size_t size = PuzzleState::size;
+
+	explicit PatternDatabase(const std::string& path)
+	: file(std::make_shared<MappedFile>(path))
+	{
+		if (file->size() < sizeof(FileHeader)) {
+			throw std::runtime_error(path + " is not a pattern database");
+		}
+		FileHeader header;
+		std::memcpy(&header, file->data(), sizeof(header));
+		if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.n != N) {
+			throw std::runtime_error(path + " is not a pattern database for this size of puzzle");
+		}
+		for (size_t i = 0; i < size; ++i)
+		{
+			goal.Set(i, header.goal[i]);
+		}
+		BuildDistances();
+
+		// the groups are disjoint and leave out the blank, so there can't be more than the tiles
+		if (header.groups >= size || sizeof(FileHeader) + header.groups * sizeof(GroupHeader) > file->size()) {
+			throw std::runtime_error(path + " is not a pattern database");
+		}
+		std::memset(groupOf, none, sizeof(groupOf));
+		const auto* entry = file->data() + sizeof(FileHeader);
+		for (uint32_t g = 0; g < header.groups; ++g, entry += sizeof(GroupHeader))
+		{
+			GroupHeader info;
+			std::memcpy(&info, entry, sizeof(info));
+			// everything a lookup trusts is checked here: which tiles, and a table for each
+			// of their placements
+			if (info.tileCount == 0 || info.tileCount >= size || info.placements != Placements(info.tileCount)) {
+				throw std::runtime_error(path + " is not a pattern database");
+			}
+			if (info.offset > file->size() || TableBytes(info.placements) > file->size() - info.offset) {
+				throw std::runtime_error(path + " is truncated");
+			}
+
+			Pattern pattern;
+			pattern.tiles.assign(info.tiles, info.tiles + info.tileCount);
+			pattern.table = file->data() + info.offset;
+			for (auto tile : pattern.tiles)
+			{
+				if (tile <= 0 || size_t(tile) >= size || groupOf[size_t(tile)] != none) {
+					throw std::runtime_error(path + " is not a pattern database");
+				}
+				groupOf[size_t(tile)] = static_cast<unsigned char>(patterns.size());
+			}
+			patterns.push_back(pattern);
+		}
+	}
+
+	const PuzzleState& Goal() const
+	{
+		return goal;
+	}
+
+	int Estimate(const PuzzleState& state) const
+	{
+		unsigned char where[size];
+		Locate(state, where);
+
+		int h = 0;
+		for (const auto& pattern : patterns)
+		{
+			h += Contribution(pattern, where);
+		}
+		return h;
+	}
+
+	// only the group owning the tile that slid can change
+	int Update(int h, const PuzzleState& parent, MOVE m) const
+	{
+		const size_t from = Board::Neighbours::cells[parent.Blank()].target[m];
+		assert(from != Board::npos);
+		const auto group = groupOf[static_cast<size_t>(parent.Get(from))];
+		if (group == none) {
+			return h;
+		}
+
+		unsigned char where[size];
+		Locate(parent, where);
+		const auto& pattern = patterns[group];
+		h -= Contribution(pattern, where);
+		where[static_cast<size_t>(parent.Get(from))] = static_cast<unsigned char>(parent.Blank());
+		return h + Contribution(pattern, where);
+	}
+
+	int operator()(const PuzzleState& state, const PuzzleState& target, int cumulativeCost) const
+	{
+		// the tables only know one goal; anything else gets the next best admissible estimate
+		if (!(target == goal)) {
+			return ManhattanDistance<N>(target)(state, target, cumulativeCost);
+		}
+		return Estimate(state) + cumulativeCost;
+	}
+
+	// Retrograde breadth first search from goal over every placement of each group, with
+	// the blank tracked so only legal moves are counted. Moving the blank through a cell
+	// outside the group is free, moving a group tile costs one. The result is written to path.
+	static void Generate(const PuzzleState& goal, const std::vector<Group>& groups, const std::string& path)
+	{
+		FileHeader header = {};
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.n = N;
+		header.groups = static_cast<uint32_t>(groups.size());
+		for (size_t i = 0; i < size; ++i)
+		{
+			header.goal[i] = static_cast<unsigned char>(goal.Get(i));
+		}
+
+		unsigned char distance[size][size];
+		Distances(goal, distance);
+
+		std::vector<GroupHeader> infos;
+		std::vector<std::vector<unsigned char>> tables;
+		uint64_t offset = Align(sizeof(FileHeader) + groups.size() * sizeof(GroupHeader));
+		// before any group is built, so a bad one doesn't waste the time the others take
+		for (const auto& group : groups)
+		{
+			if (group.size() < size && Placements(group.size()) * size > maxSearch) {
+				throw std::invalid_argument("A pattern group of " + std::to_string(group.size()) + " tiles needs "
+											+ std::to_string(Placements(group.size()) * size >> 20)
+											+ "MB to build; groups can have up to " + std::to_string(LargestGroup())
+											+ " tiles on this board");
+			}
+		}
+		bool used[size] = {};
+		for (const auto& group : groups)
+		{
+			if (group.empty() || group.size() > sizeof(GroupHeader::tiles)) {
+				throw std::invalid_argument("Pattern groups must have between 1 and 28 tiles");
+			}
+
+			for (auto tile : group)
+			{
+				if (tile <= 0 || size_t(tile) >= size || used[size_t(tile)]) {
+					throw std::invalid_argument("Pattern groups must be disjoint and must not include the blank");
+				}
+				used[size_t(tile)] = true;
+			}
+
+			GroupHeader info = {};
+			info.tileCount = static_cast<uint32_t>(group.size());
+			std::copy(group.begin(), group.end(), info.tiles);
+			info.placements = Placements(group.size());
+			info.offset = offset;
+			offset = Align(offset + TableBytes(info.placements));
+			infos.push_back(info);
+			tables.push_back(Search(goal, group, distance));
+		}
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			throw std::runtime_error("Could not create " + path);
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(infos.data()), infos.size() * sizeof(GroupHeader));
+		for (size_t i = 0; i < tables.size(); ++i)
+		{
+			out.seekp(static_cast<std::streamoff>(infos[i].offset));
+			out.write(reinterpret_cast<const char*>(tables[i].data()), tables[i].size());
+		}
+		if (!out) {
+			throw std::runtime_error("Could not write " + path);
+		}
+	}
+
+private:
+	// on disk layout; integers are stored in the byte order of the machine that built the file
+	static constexpr char magic[8] = { 'P', 'U', 'Z', 'P', 'D', 'B', '0', '1' };
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t n;
+		uint32_t groups;
+		unsigned char goal[32];
+	};
+
+	struct GroupHeader {
+		uint64_t offset;
+		uint64_t placements;
+		uint32_t tileCount;
+		unsigned char tiles[28];
+	};
+
+	struct Pattern {
+		Group tiles;
+		const unsigned char* table;
+	};
+
+	static constexpr unsigned char none = 0xFF;
+	// what Search may hold for a group: a byte for every placement and blank cell, which
+	// is 7 tiles of the 15puzzle (922MB). 8 would need 8.3GB.
+	static constexpr uint64_t maxSearch = uint64_t(1) << 30;
+
+	std::shared_ptr<const MappedFile> file;
+	PuzzleState goal;
+	std::vector<Pattern> patterns;
+	unsigned char groupOf[size];
+	unsigned char distance[size][size];
+
+	static uint64_t Align(uint64_t offset)
+	{
+		return (offset + 63) & ~uint64_t(63);
+	}
+
+	static uint64_t TableBytes(uint64_t placements)
+	{
+		return (placements + 1) / 2;
+	}
+
+	// the number of ways to put k distinct tiles on the board
+	static uint64_t Placements(size_t k)
+	{
+		uint64_t count = 1;
+		for (size_t i = 0; i < k; ++i)
+		{
+			count *= size - i;
+		}
+		return count;
+	}
+
+	static size_t LargestGroup()
+	{
+		size_t k = 1;
+		while (k + 1 < size && Placements(k + 1) * size <= maxSearch) {
+			++k;
+		}
+		return k;
+	}
+
+	// each cell is numbered among the cells not already taken by earlier tiles
+	static uint64_t Rank(const unsigned char* cells, size_t k)
+	{
+		uint64_t rank = 0;
+		for (size_t i = 0; i < k; ++i)
+		{
+			size_t digit = cells[i];
+			for (size_t j = 0; j < i; ++j)
+			{
+				digit -= (cells[j] < cells[i]);
+			}
+			rank = rank * (size - i) + digit;
+		}
+		return rank;
+	}
+
+	static void Unrank(uint64_t rank, size_t k, unsigned char* cells)
+	{
+		size_t digits[size];
+		for (size_t i = k; i-- > 0;)
+		{
+			digits[i] = rank % (size - i);
+			rank /= (size - i);
+		}
+		bool taken[size] = {};
+		for (size_t i = 0; i < k; ++i)
+		{
+			size_t cell = 0;
+			for (size_t skip = digits[i]; taken[cell] || skip; ++cell)
+			{
+				skip -= !taken[cell];
+			}
+			taken[cell] = true;
+			cells[i] = static_cast<unsigned char>(cell);
+		}
+	}
+
+	static void Distances(const PuzzleState& goal, unsigned char (&distance)[size][size])
+	{
+		for (size_t tile = 0; tile < size; ++tile)
+		{
+			const size_t home = goal.Find(static_cast<char>(tile));
+			for (size_t cell = 0; cell < size; ++cell)
+			{
+				distance[tile][cell] = static_cast<unsigned char>(
+					std::abs(int(home / N) - int(cell / N)) + std::abs(int(home % N) - int(cell % N)));
+			}
+		}
+	}
+
+	void BuildDistances()
+	{
+		Distances(goal, distance);
+	}
+
+	static void Locate(const PuzzleState& state, unsigned char* where)
+	{
+		for (size_t cell = 0; cell < size; ++cell)
+		{
+			where[static_cast<size_t>(state.Get(cell))] = static_cast<unsigned char>(cell);
+		}
+	}
+
+	int Contribution(const Pattern& pattern, const unsigned char* where) const
+	{
+		unsigned char cells[size];
+		int manhattan = 0;
+		const size_t k = pattern.tiles.size();
+		for (size_t i = 0; i < k; ++i)
+		{
+			const auto tile = static_cast<size_t>(pattern.tiles[i]);
+			cells[i] = where[tile];
+			manhattan += distance[tile][cells[i]];
+		}
+		const uint64_t rank = Rank(cells, k);
+		const int extra = (pattern.table[rank / 2] >> ((rank & 1) * 4)) & 0xF;
+		return manhattan + 2 * extra;
+	}
+
+	// 0-1 breadth first search over (placement, blank cell)
+	static std::vector<unsigned char> Search(const PuzzleState& goal, const Group& group,
+											 const unsigned char (&distance)[size][size])
+	{
+		const size_t k = group.size();
+		const uint64_t placements = Placements(k);
+		std::vector<unsigned char> cost(placements * size, none);
+		std::deque<uint64_t> open;
+
+		unsigned char cells[size];
+		for (size_t i = 0; i < k; ++i)
+		{
+			cells[i] = static_cast<unsigned char>(goal.Find(group[i]));
+		}
+		const uint64_t start = Rank(cells, k) * size + goal.Blank();
+		cost[start] = 0;
+		open.push_back(start);
+
+		while (!open.empty()) {
+			const uint64_t current = open.front();
+			open.pop_front();
+			const uint64_t rank = current / size;
+			const size_t blank = current % size;
+			const unsigned char d = cost[current];
+
+			Unrank(rank, k, cells);
+			unsigned char occupant[size];
+			std::memset(occupant, none, sizeof(occupant));
+			for (size_t i = 0; i < k; ++i)
+			{
+				occupant[cells[i]] = static_cast<unsigned char>(i);
+			}
+
+			const auto& neighbours = Board::Neighbours::cells[blank];
+			for (size_t j = 0; j < neighbours.count; ++j)
+			{
+				const size_t target = neighbours.target[neighbours.moves[j]];
+
+				const auto tile = occupant[target];
+				if (tile == none) {
+					// the blank swaps with a tile we are not tracking, which is free
+					const uint64_t next = rank * size + target;
+					if (d < cost[next]) {
+						cost[next] = d;
+						open.push_front(next);
+					}
+				} else {
+					cells[tile] = static_cast<unsigned char>(blank);
+					const uint64_t next = Rank(cells, k) * size + target;
+					cells[tile] = static_cast<unsigned char>(target);
+					if (d + 1 < cost[next]) {
+						cost[next] = static_cast<unsigned char>(d + 1);
+						open.push_back(next);
+					}
+				}
+			}
+		}
+
+		// the table only needs the best over every blank position
+		std::vector<unsigned char> table(TableBytes(placements), 0);
+		for (uint64_t rank = 0; rank < placements; ++rank)
+		{
+			unsigned char best = none;
+			for (size_t blank = 0; blank < size; ++blank)
+			{
+				best = std::min(best, cost[rank * size + blank]);
+			}
+
+			Unrank(rank, k, cells);
+			int manhattan = 0;
+			for (size_t i = 0; i < k; ++i)
+			{
+				manhattan += distance[static_cast<size_t>(group[i])][cells[i]];
+			}
+			assert(best != none && best >= manhattan && (best - manhattan) % 2 == 0);
+			// clamping only ever lowers the estimate so it stays admissible
+			const int extra = std::min((best - manhattan) / 2, 15);
+			table[rank / 2] |= static_cast<unsigned char>(extra << ((rank & 1) * 4));
+		}
+		return table;
+	}
+};
+
+template <size_t N>
+constexpr char PatternDatabase<N>::magic[8];
+template <size_t N>
+constexpr unsigned char PatternDatabase<N>::none;
+template <size_t N>
+constexpr uint64_t PatternDatabase<N>::maxSearch;
+
+#endif /* PatternDatabase_h */
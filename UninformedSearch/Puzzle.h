@@ -4,29 +4,57 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <stdexcept>
-#include <unordered_set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Frontier.h"
+#include "LayeredSearch.h"
+#include "MoveSequence.h"
+#include "MoveTable.h"
+#include "NodeArena.h"
+#include "PageMemory.h"
+#include "ParallelSearch.h"
+#include "SearchStats.h"
+#include "StateTable.h"
+#include "TranspositionTable.h"
+
+// the bidirectional search guides its side from the goal with one of these; Heuristics.h
+// is included at the end, once Puzzle is whole
+template <size_t N>
+class ManhattanDistance;
 
 class PuzzleStrategy {
 public:
-	struct SearchNode {
-		// general node members
-		const SearchNode* parent = nullptr;
-		const size_t cost = 1;
-		const size_t depth = 0;
+	using NodeIndex = uint32_t;
 
-		SearchNode(const SearchNode* parent, size_t cost)
-		: parent(parent), cost(cost),
-		depth((parent) ? parent->depth + 1 : 0) {}
+	// the part of a search node strategies order and test on.
+	// nodes are plain data owned by the search's arena and refer to their parent by index
+	struct SearchNode {
+		static constexpr NodeIndex none = NodeIndex(-1);
 
-		virtual void Trace(size_t i) const {};
-        virtual void InverseTrace(size_t i) const {};
+		NodeIndex parent = none;
+		uint32_t cost = 0;
+		uint32_t depth = 0;
 	};
 
-	using NodePtr = std::shared_ptr<const SearchNode>;
+	// the frontier only needs to know where a node lives and how to order it
+	struct FrontierEntry {
+		NodeIndex node;
+		uint32_t cost;
+		uint32_t depth;
+	};
 
 	// existing is a node == to newnode or nullptr if no such node
 	virtual bool TestHeuristics(const SearchNode& newnode, const SearchNode* existing) const
@@ -35,13 +63,9 @@ public:
 		return bool(existing) == false;
 	}
 
-	void Enqueue(const SearchNode& node) {
-		Enqueue(std::make_shared<SearchNode>(node));
-	}
-
-	void Enqueue(NodePtr node)
+	void Enqueue(const FrontierEntry& entry)
 	{
-		frontier.push(node);
+		frontier.push(entry);
 	}
 
 	void Dequeue()
@@ -49,7 +73,7 @@ public:
 		frontier.pop();
 	}
 
-	NodePtr Next() const
+	const FrontierEntry& Next() const
 	{
 		return frontier.top();
 	}
@@ -59,6 +83,17 @@ public:
 		return frontier.empty();
 	}
 
+	size_t Size() const
+	{
+		return frontier.size();
+	}
+
+	// entries refer to the arena of an earlier search so they must not outlive it
+	void Clear()
+	{
+		frontier.clear();
+	}
+
 	virtual bool ExpandSearch()
 	{
 		// by default most searches are complete and dont need expansion
@@ -78,49 +113,218 @@ public:
         return false;
     }
 
-	template <class T>
-	std::shared_ptr<T> Next() const
+	virtual bool IsIterativeDeepening() const
 	{
-		return std::static_pointer_cast<T>(Next());
+		return false;
 	}
 
-	PuzzleStrategy(std::function<bool(NodePtr&, NodePtr&)> comp)
-	: frontier(comp) {}
+	virtual bool IsLayered() const
+	{
+		return false;
+	}
+
+	// how many threads share one search; anything above one is hash distributed A*
+	virtual size_t Concurrency() const
+	{
+		return 1;
+	}
+
+	// How much more the estimate counts than the moves so far. It is a fraction so the
+	// frontier keys stay integers: a node is queued at g * denominator + h * numerator,
+	// where h is its cost less its depth. One is the plain cost.
+	struct Weight {
+		uint32_t numerator = 1;
+		uint32_t denominator = 1;
+
+		// to the nearest eighth, and never below one
+		static Weight Of(double weight)
+		{
+			Weight w;
+			w.denominator = 8;
+			w.numerator = std::max<uint32_t>(static_cast<uint32_t>(weight * 8 + 0.5), 8);
+			while (w.numerator % 2 == 0 && w.denominator % 2 == 0) {
+				w.numerator /= 2;
+				w.denominator /= 2;
+			}
+			return w;
+		}
+
+		double Value() const
+		{
+			return double(numerator) / denominator;
+		}
+
+		uint32_t Key(uint32_t cost, uint32_t depth) const
+		{
+			if (numerator == denominator) return cost;
+			const uint32_t h = (cost > depth) ? cost - depth : 0;
+			return depth * denominator + h * numerator;
+		}
+	};
+
+	virtual Weight HeuristicWeight() const
+	{
+		return Weight();
+	}
+
+	// searched as ARA* (see AnytimeSearch)
+	virtual bool IsAnytime() const
+	{
+		return false;
+	}
+
+	// every search but the bidirectional, layered and hash distributed ones keeps to it
+	void SetBudget(const SearchBudget& limit)
+	{
+		budget = limit;
+	}
+
+	const SearchBudget& Budget() const
+	{
+		return budget;
+	}
+
+	// how many nodes the frontier searches take off at once and expand together (see
+	// SolveFrontier); at least one
+	void SetBatch(size_t nodes)
+	{
+		batch = std::max<size_t>(nodes, 1);
+	}
+
+	size_t Batch() const
+	{
+		return batch;
+	}
+
+	// last in, first out, as the depth first searches are
+	bool IsStack() const
+	{
+		return frontier.Order() == Frontier<FrontierEntry>::LIFO;
+	}
+
+	using FrontierPolicy = Frontier<FrontierEntry>::Policy;
+
+	PuzzleStrategy(FrontierPolicy policy)
+	: frontier(policy) {}
 
 private:
-	std::priority_queue<NodePtr, std::vector<NodePtr>, std::function<bool(NodePtr&, NodePtr&)>> frontier;
+	Frontier<FrontierEntry> frontier;
+	SearchBudget budget;
+	size_t batch = 8;
 };
 
+// expands the lowest cost node first
 class QueueStrategy : public PuzzleStrategy
 {
 public:
 	QueueStrategy()
-	: PuzzleStrategy([](NodePtr& lhs, NodePtr& rhs)-> bool {
-		return bool(lhs->cost > rhs->cost);
-	}) {}
+	: PuzzleStrategy(Frontier<FrontierEntry>::LOWEST_COST) {}
+
+	// a state reached more cheaply than before is reopened, or A* can settle for a
+	// longer route it happened to find first
+	bool TestHeuristics(const SearchNode& newnode, const SearchNode* existing) const override
+	{
+		return !existing || newnode.cost < existing->cost;
+	}
+};
+
+// A* split across threads by state hash. Each thread keeps its own open list and
+// explored table, so the frontier owned by the strategy itself goes unused.
+class HashDistributedSearch : public QueueStrategy
+{
+public:
+	HashDistributedSearch(size_t threads = std::thread::hardware_concurrency())
+	: threads(std::max<size_t>(threads, 1)) {}
+
+	size_t Concurrency() const override
+	{
+		return threads;
+	}
+
+private:
+	size_t threads;
+};
+
+// Weighted A*: the estimate counts weight times over the moves so far, so the search
+// heads for the goal and expands far fewer nodes, and the path it finds is at most
+// weight times as long as the shortest one.
+class WeightedSearch : public QueueStrategy
+{
+public:
+	explicit WeightedSearch(double weight)
+	: weight(Weight::Of(weight)) {}
+
+	Weight HeuristicWeight() const override
+	{
+		return weight;
+	}
+
+private:
+	Weight weight;
+};
+
+// ARA* (Likhachev, Gordon and Thrun): weighted A* that starts with a large weight and
+// lowers it by step each time it finds a path, down to 1 where the path is the shortest.
+// Every search after the first carries on from the last one's nodes rather than starting
+// over, and only expands again the states it has since found a better way to. Each path
+// is handed to the puzzle's improvement callback as it is found along with how far from
+// the shortest it can be, so with a budget the best path found in time comes back.
+class AnytimeSearch : public QueueStrategy
+{
+public:
+	AnytimeSearch(double initial = 3, double step = 0.5)
+	: initial(std::max(initial, 1.0)), step(std::max(step, 0.125)) {}
+
+	bool IsAnytime() const override
+	{
+		return true;
+	}
+
+	Weight HeuristicWeight() const override
+	{
+		return Weight::Of(initial);
+	}
+
+	// the weight of the search after one that used weight
+	Weight Lower(const Weight& weight) const
+	{
+		return Weight::Of(weight.Value() - step);
+	}
+
+private:
+	double initial;
+	double step;
 };
 
 class StackStrategy : public PuzzleStrategy
 {
 public:
 	StackStrategy()
-	: PuzzleStrategy([](NodePtr& lhs, NodePtr& rhs) {
-	return bool(lhs->depth < rhs->depth);
-	}) {}
+	: PuzzleStrategy(Frontier<FrontierEntry>::LIFO) {}
+};
+
+class BreadthFirstSearch : public PuzzleStrategy
+{
+public:
+	BreadthFirstSearch()
+	: PuzzleStrategy(Frontier<FrontierEntry>::FIFO) {}
 };
 
-using BreadthFirstSearch = QueueStrategy;
 using DepthFirstSearch = StackStrategy;
 
 class DepthLimitedSearch : public DepthFirstSearch {
 protected:
 	size_t depth;
+	// megabytes of transposition table (see TranspositionTable.h), 0 for none
+	size_t table;
 
 public:
-	DepthLimitedSearch(size_t depth)
-	: depth(depth) {}
+	DepthLimitedSearch(size_t depth, size_t table = 0)
+	: depth(depth), table(table) {}
 
-	bool TestHeuristics(const SearchNode& newnode, const SearchNode* existing) const
+	// a state reached shallower than before is reopened so everything below it gets
+	// the depth it really has left
+	bool TestHeuristics(const SearchNode& newnode, const SearchNode* existing) const override
 	{
 		return (newnode.depth <= depth && (!existing || existing->depth > newnode.depth));
 	}
@@ -129,29 +333,195 @@ public:
 	{
 		return false;
 	}
+
+	// With a table there is no explored set to fill: the search runs the way IDA* does,
+	// on one board with every move undone, for a single pass at its bound.
+	bool IsIterativeDeepening() const override
+	{
+		return table != 0;
+	}
+
+	size_t Bound() const
+	{
+		return depth;
+	}
+
+	size_t Table() const
+	{
+		return table;
+	}
+
+	// search again under a higher bound; there is only the one pass here
+	virtual bool Raise(size_t)
+	{
+		return false;
+	}
+
+	// the search ran out of places to look so there is nothing left to expand into
+	virtual void Exhaust() {}
 };
 
+// Solved as IDA*: a depth first search over a single board that undoes each move on the
+// way back up, so memory is proportional to the depth and no explored set is kept.
+// The bound is on the cost, so with a heuristic each iteration raises it to the
+// cheapest cost that exceeded it last time. Given a transposition table, states already
+// searched are remembered from one iteration to the next and not searched again.
 class IterativeDeepeningSearch : public DepthLimitedSearch {
+protected:
+	size_t maxDepth;
 
 public:
-	IterativeDeepeningSearch(size_t depth)
-	: DepthLimitedSearch(depth) {}
+	// no 15-puzzle needs more than 80 moves
+	IterativeDeepeningSearch(size_t depth, size_t maxDepth = 80, size_t table = 0)
+	: DepthLimitedSearch(depth, table), maxDepth(maxDepth) {}
 
-	bool ExpandSearch()
+	bool ExpandSearch() override
+	{
+		return Raise(depth + 1);
+	}
+
+	// expand the bound and search again, or give up once we would pass maxDepth
+	bool Raise(size_t bound) override
+	{
+		if (bound > maxDepth) {
+			depth = maxDepth;
+			return false;
+		}
+		depth = bound;
+		return true;
+	}
+
+	void Exhaust() override
+	{
+		depth = maxDepth;
+	}
+
+	bool IsIterativeDeepening() const override
 	{
-		// FIXME: we need a max depth or we would loop infinitely on an unsolvable puzzle
-		// expand the depth and search again
-		++depth;
-		std::cout << "Expanding search depth to " << depth << std::endl;
 		return true;
 	}
 };
 
+// Searches from both ends at once and stops when the two searches meet.
+// Uninformed it grows whichever side has the smaller frontier a layer at a time.
+// With a heuristic it is MM (Holte et al.): each side expands in order of
+// max(f, 2g), so neither one goes past the midpoint of an optimal path.
 class BiDirectionalSearch : public BreadthFirstSearch {
 
 public:
-	BiDirectionalSearch() : BreadthFirstSearch() {}
+	BiDirectionalSearch(bool heuristic = false) : BreadthFirstSearch(), heuristic(heuristic) {}
     bool IsBiDirectional() const override { return true; }
+
+	bool IsHeuristic() const
+	{
+		return heuristic;
+	}
+
+private:
+	bool heuristic;
+};
+
+// Breadth first a layer at a time with no closed list (see LayeredSearch.h). memory, in
+// bytes, caps what is held before layers spill to files in directory; without a
+// directory everything stays in memory.
+class FrontierBreadthFirstSearch : public BreadthFirstSearch {
+public:
+	FrontierBreadthFirstSearch(size_t memory = 0, const std::string& directory = std::string())
+	: memory(memory), directory(directory) {}
+
+	bool IsLayered() const override
+	{
+		return true;
+	}
+
+	size_t Memory() const
+	{
+		return memory;
+	}
+
+	const std::string& Directory() const
+	{
+		return directory;
+	}
+
+private:
+	size_t memory;
+	std::string directory;
+};
+
+// Board storage. Boards of up to 16 cells pack each tile into a nibble of a single
+// word so copies, comparisons and hashes are one machine word apiece.
+// Larger boards fall back to a byte per tile.
+template <size_t Size, bool Packed = (Size <= 16)>
+struct TileStorage {
+	char tiles[Size] = {};
+
+	char Get(size_t i) const
+	{
+		return tiles[i];
+	}
+
+	void Set(size_t i, char value)
+	{
+		tiles[i] = value;
+	}
+
+	// move the tile at from into the blank cell to
+	void Slide(size_t from, size_t to)
+	{
+		tiles[to] = tiles[from];
+		tiles[from] = 0;
+	}
+
+	bool operator==(const TileStorage& rhs) const
+	{
+		return std::memcmp(tiles, rhs.tiles, Size) == 0;
+	}
+
+	// FNV-1a
+	size_t hash() const
+	{
+		uint64_t h = 14695981039346656037ull;
+		for (size_t i = 0; i < Size; ++i)
+		{
+			h = (h ^ static_cast<unsigned char>(tiles[i])) * 1099511628211ull;
+		}
+		return static_cast<size_t>(h ^ (h >> 32));
+	}
+};
+
+template <size_t Size>
+struct TileStorage<Size, true> {
+	uint64_t word = 0;
+
+	char Get(size_t i) const
+	{
+		return static_cast<char>((word >> (4 * i)) & 0xF);
+	}
+
+	void Set(size_t i, char value)
+	{
+		const auto shift = 4 * i;
+		word = (word & ~(uint64_t(0xF) << shift)) | (uint64_t(value & 0xF) << shift);
+	}
+
+	// the blank cell is all zero bits so one xor both clears from and fills in to
+	void Slide(size_t from, size_t to)
+	{
+		const uint64_t tile = (word >> (4 * from)) & 0xF;
+		word ^= (tile << (4 * from)) | (tile << (4 * to));
+	}
+
+	bool operator==(const TileStorage& rhs) const
+	{
+		return word == rhs.word;
+	}
+
+	// every tile is significant so mix the bits before handing them to a table (see Mix)
+	size_t hash() const
+	{
+		return static_cast<size_t>(Mix(word));
+	}
 };
 
 template<size_t N>
@@ -169,198 +539,313 @@ public:
 		static constexpr auto n = N;
 		static constexpr auto size = N*N;
 
-		char state[N][N] = {};
+		using Grid = char[N][N];
 
 		PuzzleState() = default;
 
-		PuzzleState(std::initializer_list<decltype(state)> l)
+		PuzzleState(std::initializer_list<Grid> l)
 		{
 			const auto start = &l.begin()[0][0][0];
-			std::copy(start, start + size, begin());
+			for (size_t i = 0; i < size; ++i)
+			{
+				Set(i, start[i]);
+			}
 		}
 
-		PuzzleState(const PuzzleState& p)
+		char Get(size_t i) const
 		{
-			std::copy(p.begin(), p.end(), begin());
+			return tiles.Get(i);
 		}
 
-		PuzzleState& operator=(const PuzzleState& p)
+		// setting the blank tile also records where it is
+		void Set(size_t i, char value)
 		{
-			if (&p != this) {
-				std::copy(p.begin(), p.end(), begin());
+			tiles.Set(i, value);
+			if (value == 0) {
+				blank = static_cast<unsigned char>(i);
 			}
-			return *this;
 		}
 
-		decltype(state[N])& operator[](size_t i)
+		char operator()(size_t row, size_t col) const
 		{
-			return state[i];
+			return Get(row * N + col);
 		}
 
-		bool operator==(const PuzzleState& rhs) const
+		size_t Blank() const
 		{
-			// we don't have to check *all* the elements
-			// since each puzzle alwyas has the same numbers we only have to check n - 1
-			for (auto i = 0; i < size - 1; ++i)
-			{
-				if (*nth(i) != *rhs.nth(i)) {
-					return false;
-				}
-			}
-			return true;
+			return blank;
 		}
 
-		size_t hash() const
+		// slide the tile at i into the blank cell; i must be adjacent to the blank
+		void Slide(size_t i)
 		{
-			static const size_t lg = log2(size); // calculate only once
-
-			size_t h = 0;
-			for (auto i = 0; i < size; ++i)
-			{
-				h |= i << ((*nth(i)) * lg);
-			}
-			return h;
+			tiles.Slide(i, blank);
+			blank = static_cast<unsigned char>(i);
 		}
 
-		int Inversions(const PuzzleState& /*goal*/) const
+		size_t Find(char value) const
 		{
-			// FIXME: technically we should examine our goal state
-			// this is hardcoded for our particular goal state :(
-
-			// the first tile always will have inversions equal to its value - 1, unless it is 0
-			int inversions = std::max(*begin() - 1, 0);
-			for (auto i = 1; i < size - 1; ++i)
+			for (size_t i = 0; i < size; ++i)
 			{
-				const auto cell = nth(i);
-				const auto val = *cell;
-
-				// no tile is smaller than 1 (since blank tile is *always* ignored in this calculation
-				if (val > 1) {
-					size_t matches = std::count_if(cell+1, end(), [&val](const char& v) {
-						return v && v < val;
-					});
-					assert(matches < size - i);
-					inversions += matches;
+				if (Get(i) == value) {
+					return i;
 				}
 			}
-			return inversions;
+			return size;
 		}
 
-		using iterator = decltype(&state[0][0]);
-		using const_iterator = const char*;
+		// the whole board as one word, for boards that pack into one
+		uint64_t Key() const
+		{
+			static_assert(size <= 16, "only boards of up to 16 cells pack into a word");
+			return tiles.word;
+		}
 
-		// providing iterators so we can easily navigate the 2d array as a flat structure
-		iterator begin()
+		static PuzzleState FromKey(uint64_t key)
 		{
-			return (iterator)&state;
+			PuzzleState state;
+			state.tiles.word = key;
+			state.blank = static_cast<unsigned char>(state.Find(0));
+			return state;
 		}
 
-		const_iterator begin() const
+		bool operator==(const PuzzleState& rhs) const
 		{
-			return (const_iterator)&state;
+			// the blank position is implied by the tiles so they are all we need to compare
+			return tiles == rhs.tiles;
 		}
 
-		iterator end()
+		bool operator!=(const PuzzleState& rhs) const
 		{
-			return begin() + size;
+			return !(*this == rhs);
 		}
 
-		const_iterator end() const
+		size_t hash() const
 		{
-			return begin() + size;
+			return tiles.hash();
 		}
 
-		iterator nth(size_t n)
+		// pairs of tiles (the blank left out) that are in the opposite order to the one they
+		// have in goal, counted with a Fenwick tree over the goal order in size log size
+		int Inversions(const PuzzleState& goal) const
 		{
-			return &state[n / N][n % N];
+			unsigned char rank[size];
+			for (size_t i = 0, r = 0; i < size; ++i)
+			{
+				if (goal.Get(i)) {
+					rank[size_t(goal.Get(i))] = static_cast<unsigned char>(r++);
+				}
+			}
+
+			// tree[k - 1] counts the tiles placed so far with a rank in (k - lowbit(k), k]
+			unsigned char tree[size] = {};
+			int inversions = 0;
+			size_t placed = 0;
+			for (size_t i = 0; i < size; ++i)
+			{
+				const auto tile = Get(i);
+				if (!tile) continue;
+				const size_t r = rank[size_t(tile)] + 1;
+				size_t before = 0;
+				for (size_t k = r; k > 0; k &= k - 1)
+				{
+					before += tree[k - 1];
+				}
+				// everything placed that doesn't come before this tile in goal comes after it
+				inversions += int(placed - before);
+				for (size_t k = r; k < size; k += k & (0 - k))
+				{
+					++tree[k - 1];
+				}
+				++placed;
+			}
+			return inversions;
 		}
 
-		const_iterator nth(size_t n) const
+		// Every move swaps the blank with a neighbour, which flips the parity of the
+		// permutation taking us to goal and of the blank's distance from its goal cell
+		// together. Those two parities have to agree for goal to be reachable, and that is
+		// enough: any N, any goal, in one pass over the cells.
+		bool Solvable(const PuzzleState& goal) const
 		{
-			return &state[n / N][n % N];
+			unsigned char home[size];
+			for (size_t i = 0; i < size; ++i)
+			{
+				home[size_t(goal.Get(i))] = static_cast<unsigned char>(i);
+			}
+
+			// a permutation of size cells made of c cycles is size - c swaps
+			bool visited[size] = {};
+			size_t cycles = 0;
+			for (size_t i = 0; i < size; ++i)
+			{
+				if (visited[i]) continue;
+				++cycles;
+				for (size_t j = i; !visited[j]; j = home[size_t(Get(j))])
+				{
+					visited[j] = true;
+				}
+			}
+
+			const size_t from = Blank(), to = goal.Blank();
+			const size_t rows = (from / N > to / N) ? from / N - to / N : to / N - from / N;
+			const size_t cols = (from % N > to % N) ? from % N - to % N : to % N - from % N;
+			return (size - cycles) % 2 == (rows + cols) % 2;
 		}
 
 		friend std::ostream& operator<<(std::ostream& os, const typename Puzzle<N>::PuzzleState& state)
 		{
-			for (auto i = 0; i < state.size; ++i)
+			for (size_t i = 0; i < state.size; ++i)
 			{
 				if (i && i % state.n == 0) {
-					std::cout << std::endl;
+					os << '\n';
+				} else if (i && state.size > 10) {
+					os << ' ';
+				}
+				// once tiles take two digits they are spaced out and lined up
+				const int tile = static_cast<int>(state.Get(i));
+				if (state.size > 10 && tile < 10) {
+					os << ' ';
 				}
-				std::cout << static_cast<int>(*state.nth(i));
+				os << tile;
 			}
-			std::cout << std::endl;
+			// no flush: a path prints a board per move and the caller decides when to flush
+			os << '\n';
 			return os;
 		}
+
+	private:
+		TileStorage<size> tiles;
+		unsigned char blank = 0;
 	};
 
 	using CostCalc = std::function<int(const PuzzleState&, const PuzzleState&, int)>;
+	// the cost of the child reached from parent by a move, worked out from the parent's cost
+	using CostUpdate = std::function<int(int, const PuzzleState&, MOVE)>;
 
-private:
-	PuzzleState state;
+	static constexpr size_t npos = PuzzleState::size;
 
-	char* blank = nullptr;
+	// legal moves and where they lead for every cell, built at compile time
+	using Neighbours = MoveTable<N>;
+	static_assert(UP == 1 && DOWN == 2 && LEFT == 3 && RIGHT == 4, "MoveTable numbers the moves this way");
+	static_assert(Neighbours::none == npos, "MoveTable and Puzzle must agree on off the board");
 
-	void Swap(char*& ptr)
+	// the cell the blank would swap with, or npos if the move leaves the board
+	static size_t GetMove(size_t blank, MOVE m)
 	{
-		std::swap(*ptr, *blank);
-		blank = ptr;
-		ptr = nullptr;
+		if (m > RIGHT) {
+			throw std::logic_error("Invalid movement command attempted");
+		}
+		return Neighbours::cells[blank].target[m];
+	}
 
-		//cout << "new state:" << endl << state;
+	static MOVE Inverse(MOVE m)
+	{
+		static const MOVE inverse[] = { NONE, DOWN, UP, RIGHT, LEFT };
+		return inverse[m];
 	}
 
-	char* GetMoveDown()
+	using Moves = MoveSequence<MOVE>;
+
+	// what Solve hands back: how the search went and, if it worked, how to get there
+	struct Solution {
+		SearchStats stats;
+		Moves path;
+
+		explicit operator bool() const
+		{
+			return stats.solved;
+		}
+	};
+
+	using Improvement = std::function<void(const Solution&)>;
+	using Progress = std::function<void(const SearchProgress&)>;
+
+private:
+	PuzzleState state;
+	std::ostream* log = &std::cout;
+	Improvement improved;
+	Progress progress;
+	SearchStats stats;
+	Moves path;
+	std::chrono::steady_clock::time_point started;
+
+	// Searches look up from their work by calling this once their expansions reach
+	// checkAt, so the rest of the time it costs them one compare. Progress is reported
+	// and true comes back if the budget is spent; checkAt moves on to the next check,
+	// an interval on or at the node budget.
+	bool Interrupted(const SearchBudget& budget, size_t expanded, size_t bound, size_t frontier, size_t& checkAt)
 	{
-		char* swp = blank + state.n;
-		return (swp < state.end()) ? swp : nullptr;
+		const auto elapsed = std::chrono::steady_clock::now() - started;
+		if (progress) {
+			progress({ expanded, bound, frontier, elapsed });
+		}
+		checkAt = expanded + size_t(SearchBudget::interval);
+		if (budget.nodes > expanded && budget.nodes < checkAt) {
+			checkAt = budget.nodes;
+		}
+		if (budget.Spent(expanded, elapsed)) {
+			stats.stopped = true;
+			return true;
+		}
+		return false;
 	}
 
-	char* GetMoveUp()
+	// the search is over so its clock stops here
+	void Record(bool solved, size_t expanded, size_t created, size_t depth)
 	{
-		char* swp = blank - state.n;
-		return (swp >= state.begin()) ? swp : nullptr;
+		stats.elapsed = std::chrono::steady_clock::now() - started;
+		stats.solved = solved;
+		stats.expanded = expanded;
+		stats.created = created;
+		stats.depth = depth;
+		stats.resident = PageMemory::Resident();
 	}
 
-	char* GetMoveRight()
+	// a search node is plain data: no vtable, no reference count
+	struct Node : public PuzzleStrategy::SearchNode {
+		PuzzleState state;
+		MOVE action = NONE;
+	};
+
+	using Arena = NodeArena<Node>;
+
+	static Node Root(const PuzzleState& state)
 	{
-		char* swp = blank + 1;
-		return (swp < state.end() && (swp - state.begin()) % state.n != 0) ? swp : nullptr;
+		Node root;
+		root.state = state;
+		return root;
 	}
 
-	char* GetMoveLeft()
+	// fills in child with the result of moving the blank of parent; the move has to stay on the board
+	static void MakeChild(const Node& parent, PuzzleStrategy::NodeIndex index, MOVE action, Node& child)
 	{
-		char* swp = blank - 1;
-		return (swp >= state.begin() && (state.end() - swp) % state.n != 1) ? swp : nullptr;
+		const size_t target = Neighbours::cells[parent.state.Blank()].target[action];
+		assert(target != npos);
+		child.state = parent.state;
+		child.state.Slide(target);
+		child.parent = index;
+		child.depth = parent.depth + 1;
+		child.action = action;
 	}
 
-	char* GetMove(MOVE m)
+	// plays a solution back on our own board
+	void Play(const Moves& moves)
 	{
-		switch (m)
+		for (auto m : moves)
 		{
-			case UP:
-				return GetMoveUp();
-			case DOWN:
-				return GetMoveDown();
-			case LEFT:
-				return GetMoveLeft();
-			case RIGHT:
-				return GetMoveRight();
-			default:
-				throw std::logic_error("Invalid movement command attempted");
+			Move(m);
 		}
 	}
 
+
 public:
 
 	Puzzle(const PuzzleState& initial)
 	: state(initial)
 	{
-		auto it = find_if(state.begin(), state.end(), bind2nd(std::equal_to<char>(), 0));
-		assert(it != state.end()); // we must have a blank tile!
-		blank = &(*it);
-		assert(*blank == 0);
-		// these asserts dont catch if there is more than one 0 so our puzzle may still be invalid
+		assert(state.Get(state.Blank()) == 0); // we must have a blank tile!
+		// this assert doesnt catch if there is more than one 0 so our puzzle may still be invalid
 	}
 
 	const PuzzleState& State() const
@@ -368,233 +853,869 @@ public:
 		return state;
 	}
 
-	auto operator[](size_t i) -> decltype(state[i])
+	// where Solve reports progress; nullptr keeps it quiet
+	void SetLog(std::ostream* out)
+	{
+		log = out;
+	}
+
+	// called by an anytime search with each better path as it finds it; nullptr for none
+	void SetImprovement(Improvement callback)
 	{
-		return state[i];
+		improved = callback;
+	}
+
+	// called every SearchBudget::interval expansions, on the thread doing the search
+	void SetProgress(Progress callback)
+	{
+		progress = callback;
+	}
+
+	// the outcome of the last Solve
+	const SearchStats& Stats() const
+	{
+		return stats;
+	}
+
+	// the moves the last Solve found, empty if it found none
+	const Moves& Path() const
+	{
+		return path;
+	}
+
+	char operator()(size_t row, size_t col) const
+	{
+		return state(row, col);
 	}
 
-	// we cant actually use this for anything but testing
 	bool HasSolution(const PuzzleState& goal) const
 	{
-		return state.Inversions(goal) % 2 == 0;
+		return state.Solvable(goal);
+	}
+
+	// nothing is printed; the board is left where the search stopped
+	Solution Solve(const PuzzleState& goal, PuzzleStrategy& strategy,
+				   CostCalc valuator = [](const PuzzleState&, const PuzzleState&, int cumulativeCost) {
+					   return cumulativeCost;
+				   },
+				   // optional: when given, children are costed from their parent instead of by valuator
+				   CostUpdate update = nullptr)
+	{
+		return Dispatch(goal, strategy, FunctionCost{ goal, valuator, update }, valuator, update);
+	}
+
+	// The same again with a heuristic whose type is known here, so costing a child is a
+	// direct call that can inline instead of a trip through std::function. It needs
+	// Estimate(state) and Update(h, parent, move) towards its own goal, which has to be
+	// goal, as ManhattanDistance, MisplacedTiles and PatternDatabase have. stepCost is
+	// what each move adds: 1 for A*, 0 for a greedy search.
+	template <class Heuristic, class = decltype(std::declval<const Heuristic&>().Estimate(std::declval<const PuzzleState&>()))>
+	Solution Solve(const PuzzleState& goal, PuzzleStrategy& strategy, const Heuristic& heuristic, int stepCost = 1)
+	{
+		if (!(heuristic.Goal() == goal)) {
+			throw std::logic_error("The heuristic was built for a different goal");
+		}
+		// only the bidirectional search needs heuristic's costs towards our start as well,
+		// and it is the one search that goes on taking them through std::function
+		const CostCalc valuator = [&heuristic, stepCost](const PuzzleState& state, const PuzzleState& target, int cumulativeCost) {
+			return heuristic(state, target, 0) + stepCost * cumulativeCost;
+		};
+		const CostUpdate update = [&heuristic, stepCost](int cost, const PuzzleState& parent, MOVE m) {
+			return heuristic.Update(cost + stepCost, parent, m);
+		};
+		return Dispatch(goal, strategy, HeuristicCost<Heuristic>{ heuristic, stepCost }, valuator, update);
+	}
+
+	// How the engines put a cost on a node. Root costs the start. A child is costed from
+	// its parent and the move that made it by Update when the cost is Incremental, and
+	// otherwise from scratch by Score. FunctionCost is the type erased one every CostCalc
+	// goes through; HeuristicCost calls a heuristic directly.
+	struct FunctionCost {
+		const PuzzleState& goal;
+		const CostCalc& valuator;
+		const CostUpdate& update;
+
+		int Root(const PuzzleState& state) const
+		{
+			return valuator(state, goal, 0);
+		}
+
+		bool Incremental() const
+		{
+			return bool(update);
+		}
+
+		int Update(int cost, const PuzzleState& parent, MOVE m) const
+		{
+			return update(cost, parent, m);
+		}
+
+		int Score(const PuzzleState& state, int depth) const
+		{
+			return valuator(state, goal, depth);
+		}
+	};
+
+	template <class Heuristic>
+	struct HeuristicCost {
+		const Heuristic& heuristic;
+		int stepCost;
+
+		int Root(const PuzzleState& state) const
+		{
+			return heuristic.Estimate(state);
+		}
+
+		bool Incremental() const
+		{
+			return true;
+		}
+
+		int Update(int cost, const PuzzleState& parent, MOVE m) const
+		{
+			return heuristic.Update(cost + stepCost, parent, m);
+		}
+
+		int Score(const PuzzleState& state, int depth) const
+		{
+			return heuristic.Estimate(state) + stepCost * depth;
+		}
+	};
+
+	// valuator and update are cost type erased, for the bidirectional search
+	template <class Cost>
+	Solution Dispatch(const PuzzleState& goal, PuzzleStrategy& strategy, const Cost& cost,
+					  const CostCalc& valuator, const CostUpdate& update)
+	{
+		stats = SearchStats();
+		path.clear();
+		started = std::chrono::steady_clock::now();
+		if (!HasSolution(goal)) {
+			// no search could get there, so don't start one
+			Record(false, 0, 0, 0);
+		} else if (strategy.IsIterativeDeepening()) {
+			SolveIterativeDeepening(goal, static_cast<DepthLimitedSearch&>(strategy), cost);
+		} else if (strategy.IsLayered()) {
+			SolveLayered(goal, static_cast<FrontierBreadthFirstSearch&>(strategy), std::integral_constant<bool, (N*N <= 16)>());
+		} else if (strategy.IsBiDirectional()) {
+			SolveBiDirectional(goal, static_cast<BiDirectionalSearch&>(strategy), valuator, update);
+		} else if (strategy.IsAnytime()) {
+			SolveAnytime(goal, static_cast<AnytimeSearch&>(strategy), cost);
+		} else if (strategy.Concurrency() > 1) {
+			SolveHashDistributed(goal, strategy.Concurrency(), cost);
+		} else {
+			SolveFrontier(goal, strategy, cost);
+		}
+		return { stats, path };
 	}
 
-	bool Solve(const PuzzleState& goal, PuzzleStrategy& strategy,
-			   CostCalc valuator = [](const PuzzleState&, const PuzzleState&, int cumulativeCost) {
-				   return cumulativeCost;
-			   })
+	// one frontier, ordered by the strategy, and one explored table
+	template <class Cost>
+	bool SolveFrontier(const PuzzleState& goal, PuzzleStrategy& strategy, const Cost& cost)
 	{
-		struct Node : public PuzzleStrategy::SearchNode {
-		private:
-			static PuzzleState PuzzleStateFromDir(MOVE action, const PuzzleStrategy::SearchNode& parent)
+		using NodeIndex = PuzzleStrategy::NodeIndex;
+
+		// every node of this search lives in the arena and is released when we return
+		Arena nodes;
+		// initialize the frontier with the start state
+		PuzzleStrategy& frontier = strategy; // alias the strategy for easy to follow terminology
+		frontier.Clear();
+		// queued by cost unless the strategy weights the estimate (see WeightedSearch)
+		const PuzzleStrategy::Weight weight = strategy.HeuristicWeight();
+		const SearchBudget& budget = strategy.Budget();
+		// incremental costs are relative to the root so it needs a real one
+		Node root = Root(state);
+		root.cost = cost.Root(state);
+		NodeIndex current = nodes.Allocate(root);
+		frontier.Enqueue({current, weight.Key(root.cost, 0), 0});
+
+		using ExploredTable = StateTable<PuzzleState, NodeIndex>;
+		ExploredTable explored(1 << 16, PuzzleStrategy::SearchNode::none);
+		explored.Insert(state, current);
+		size_t expandedCount = 0, createdCount = 1;
+
+		// A child waiting to be looked up. The candidate lives on the stack until it passes
+		// the heuristics test so rejected children never touch the arena.
+		struct Pending {
+			Node child;
+			size_t address;
+		};
+		// a stack expands a node's children before anything else it holds, so the depth
+		// first searches go a node at a time
+		const size_t batch = (strategy.IsStack()) ? 1 : strategy.Batch();
+		std::vector<Pending> pending;
+		pending.reserve(batch * 4);
+
+		auto MakePending = [&](MOVE direction) {
+			Pending next;
+			Node& child = next.child;
+			const Node& p = nodes[current];
 			{
-				assert(action); // dont accept NONE as a valid sequence
-				// less than ideal, but create a new puzzle with the parent state
-				// manipulate it, then destroy it
-				const Node& p = static_cast<const Node&>(parent);
-				Puzzle puzzle(p.state);
-				puzzle.Move(action);
-				return puzzle.State();
+				SEARCH_TIMER(stats.expansion);
+				MakeChild(p, current, direction, child);
 			}
+			++stats.generated;
+			{
+				SEARCH_TIMER(stats.heuristic);
+				child.cost = (cost.Incremental()) ? cost.Update(p.cost, p.state, direction) : cost.Score(child.state, child.depth);
+			}
+			SEARCH_TIMER(stats.hashing);
+			next.address = explored.Address(child.state);
+			explored.Prefetch(next.address);
+			pending.push_back(next);
+		};
 
-			Node(const PuzzleState& state, const Node& parent, MOVE action, std::function<int(const PuzzleState&)> calc)
-			: state(state), PuzzleStrategy::SearchNode(&parent, calc(state)), action(action) {}
+		auto Resolve = [&](const Pending& next) {
+			const Node& child = next.child;
+			const Node* existing = nullptr;
+			NodeIndex seen = Node::none;
+			{
+				SEARCH_TIMER(stats.hashing);
+				auto found = explored.Find(child.state, next.address);
+				if (found) {
+					seen = *found;
+					existing = &nodes[seen];
+				}
+			}
+			if (!strategy.TestHeuristics(child, existing)) {
+				if (existing) {
+					++stats.duplicates;
+				}
+			} else if (existing) {
+				// A better way to a state we already have. Its node takes the new parent
+				// and cost where it is, so the table still points at it, and is queued
+				// again; the entry it had is left behind to be skipped when it comes up.
+				SEARCH_TIMER(stats.expansion);
+				nodes[seen] = child;
+				frontier.Enqueue({seen, weight.Key(child.cost, child.depth), child.depth});
+				++stats.reopened;
+			} else {
+				NodeIndex index;
+				{
+					SEARCH_TIMER(stats.expansion);
+					index = nodes.Allocate(child);
+					frontier.Enqueue({index, weight.Key(child.cost, child.depth), child.depth});
+				}
+				SEARCH_TIMER(stats.hashing);
+				explored.Insert(child.state, index, next.address);
+				++createdCount;
+			}
+		};
+
+		// Nodes are expanded a batch at a time: every child of the batch is made and its
+		// slot in the explored table prefetched, and only then are they looked up, in the
+		// order they were made. The lookups are mostly cache misses, so this way they are
+		// waited on together rather than one after another.
+		//
+		// A batch only holds nodes queued at the key it started with. With a consistent
+		// heuristic no child of theirs comes in below it, so taking them together is
+		// taking them in order; a node at another key, or the goal, is left where it is
+		// for the next batch, which takes it once the children ahead of it are queued.
+		size_t checkAt = 0;
+		bool finished = false;
+		while (!finished && !frontier.Finished()) {
+			pending.clear();
+			uint32_t key = 0;
+			for (size_t taken = 0; taken < batch && !frontier.Finished();) {
+				const auto entry = frontier.Next();
+				// A node only ever gets shallower when it is reopened (a cost is its estimate,
+				// which belongs to the state, plus its depth), so an entry queued at another
+				// depth than its node's is stale. The depth is its generation stamp and nothing
+				// extra is stored.
+				if (entry.depth != nodes[entry.node].depth) {
+					frontier.Dequeue();
+					continue;
+				}
+				const bool reached = nodes[entry.node].state == goal;
+				if (taken && (reached || entry.cost != key)) break;
+				frontier.Dequeue();
+				current = entry.node;
+				key = entry.cost;
+
+				finished = reached ||
+					(expandedCount >= checkAt && Interrupted(budget, expandedCount, nodes[current].cost, frontier.Size(), checkAt));
+				if (finished) break;
+
+				// counterclockwise, skipping the move back to the parent since it has been seen already
+				++expandedCount;
+				++taken;
+				const auto& moves = Neighbours::cells[nodes[current].state.Blank()];
+				const MOVE back = Inverse(nodes[current].action);
+				for (size_t i = 0; i < moves.count; ++i)
+				{
+					const MOVE m = static_cast<MOVE>(moves.moves[i]);
+					if (m != back) MakePending(m);
+				}
+			}
+			for (const auto& next : pending)
+			{
+				// a parent reopened by a child ahead of it in the batch is queued again, and
+				// its children are made from where it is now when that entry comes up
+				if (nodes[next.child.parent].depth + 1 != next.child.depth) continue;
+				Resolve(next);
+			}
+			stats.peakFrontier = std::max(stats.peakFrontier, frontier.Size());
+		}
 
-		public:
-			const PuzzleState state;
-			const MOVE action;
+		// update puzzle to current state (even if not solved)
+		state = nodes[current].state;
 
-			// constructor for root node
-			Node(const PuzzleState& state)
-			: PuzzleStrategy::SearchNode(nullptr,0), state(state), action(MOVE::NONE) {}
+		// nothing is ever removed from the arena or the table so they peak at the end
+		stats.peakExplored = explored.size();
+		stats.bytes = nodes.bytes() + explored.bytes() + stats.peakFrontier * sizeof(PuzzleStrategy::FrontierEntry);
+		bool solved = IsSolved(goal);
+		if (solved) {
+			path.reserve(nodes[current].depth);
+			for (NodeIndex i = current; nodes[i].parent != Node::none; i = nodes[i].parent)
+			{
+				path.push_back(nodes[i].action);
+			}
+			path.reverse();
+		}
+		// a node's depth is from when it was reached, and its ancestors may have been
+		// reopened closer to the root since, so the path it ends is never any longer
+		assert(!solved || path.size() <= nodes[current].depth);
+		Record(solved, expandedCount, createdCount, (solved) ? path.size() : nodes[current].depth);
+		if (solved && weight.numerator != weight.denominator) {
+			stats.bound = weight.Value();
+		}
+		return solved;
+	}
 
-			// constructor for child nodes
-			Node(const Node& parent, MOVE action, std::function<int(const PuzzleState&)> calc)
-			: Node(PuzzleStateFromDir(action, parent), parent, action, calc) {}
+	// ARA*. Each pass is weighted A* until nothing queued could lead to a goal cheaper than
+	// the one found, under that pass's weight. A state reached a better way after this pass
+	// expanded it waits to one side (INCONS) rather than being expanded again, and what is
+	// left queued and waiting is queued again under the next, lower weight. The cheapest
+	// cost of all those is a lower bound on the shortest path, so each path comes with
+	// how far from the shortest it can be.
+	template <class Cost>
+	bool SolveAnytime(const PuzzleState& goal, AnytimeSearch& strategy, const Cost& cost)
+	{
+		using NodeIndex = PuzzleStrategy::NodeIndex;
+		using Weight = PuzzleStrategy::Weight;
+		const NodeIndex none = PuzzleStrategy::SearchNode::none;
+		const SearchBudget& budget = strategy.Budget();
+		Weight weight = strategy.HeuristicWeight();
+
+		Arena nodes;
+		PuzzleStrategy& open = strategy;
+		open.Clear();
+		Node root = Root(state);
+		root.cost = cost.Root(state);
+		NodeIndex current = nodes.Allocate(root);
+		open.Enqueue({current, weight.Key(root.cost, 0), 0});
+
+		StateTable<PuzzleState, NodeIndex> explored(1 << 16, none);
+		explored.Insert(state, current);
+		// the pass each node was last expanded in, 0 for none
+		std::vector<uint32_t> closed(1, 0);
+		std::vector<NodeIndex> inconsistent;
+		uint32_t pass = 1;
+		size_t expandedCount = 0, createdCount = 1, checkAt = 0;
+		NodeIndex found = (state == goal) ? current : none;
+		size_t published = size_t(-1);
+
+		// drops entries left behind when their node was reached again in fewer moves
+		auto Top = [&] {
+			while (!open.Finished() && open.Next().depth != nodes[open.Next().node].depth) {
+				open.Dequeue();
+			}
+			return !open.Finished();
+		};
 
-			bool operator==(const Node& rhs) const
+		auto ExpandNode = [&](MOVE direction) {
+			Node child;
+			const Node& p = nodes[current];
+			{
+				SEARCH_TIMER(stats.expansion);
+				MakeChild(p, current, direction, child);
+			}
+			++stats.generated;
 			{
-				// we consider equality based on state alone
-				return state == rhs.state;
+				SEARCH_TIMER(stats.heuristic);
+				child.cost = (cost.Incremental()) ? cost.Update(p.cost, p.state, direction) : cost.Score(child.state, child.depth);
 			}
 
-			void Trace(size_t i) const
+			NodeIndex index;
+			bool seen;
 			{
-				if (parent) {
-					if (i == 0)
-						std::cout << "Truncated trace route:" << std::endl;
-					else {
-						parent->Trace(--i);
-
-						static const char* symbols[] = {"", "UP","DOWN","LEFT","RIGHT"};
-						std::cout << depth << ": " << symbols[action] << std::endl;
-						std::cout << state << std::endl;
-					}
+				SEARCH_TIMER(stats.hashing);
+				auto existing = explored.Find(child.state);
+				seen = bool(existing);
+				if (seen) {
+					index = *existing;
 				} else {
-					std::cout << "Path taken to solve:" << std::endl;
+					index = nodes.Allocate(child);
+					explored.Insert(child.state, index);
+					closed.push_back(0);
+					++createdCount;
 				}
 			}
-            
-            // To get the correct move from the "backwards" search it has to have the order and value reversed.
-            // ex. from the goal state, the moves UP, LEFT, DOWN, RIGHT would be LEFT, UP, RIGHT, DOWN.
-			void InverseTrace(size_t i) const
+			if (seen) {
+				// in place, as SolveFrontier does; expanded already this pass, it waits for the next
+				if (nodes[index].cost <= child.cost) {
+					++stats.duplicates;
+					return;
+				}
+				nodes[index] = child;
+				++stats.reopened;
+				if (closed[index] == pass) {
+					inconsistent.push_back(index);
+					return;
+				}
+			}
+			if (child.state == goal) {
+				found = index;
+			}
+			open.Enqueue({index, weight.Key(child.cost, child.depth), child.depth});
+		};
+
+		// one pass; false if the budget ran out first
+		auto Improve = [&] {
+			while (Top()) {
+				const auto entry = open.Next();
+				if (found != none && weight.Key(nodes[found].cost, nodes[found].depth) <= entry.cost) break;
+				open.Dequeue();
+				current = entry.node;
+				if (nodes[current].state == goal) continue;
+				if (expandedCount >= checkAt && Interrupted(budget, expandedCount, nodes[current].cost, open.Size(), checkAt)) return false;
+
+				closed[current] = pass;
+				++expandedCount;
+				const auto& moves = Neighbours::cells[nodes[current].state.Blank()];
+				const MOVE back = Inverse(nodes[current].action);
+				for (size_t i = 0; i < moves.count; ++i)
+				{
+					const MOVE m = static_cast<MOVE>(moves.moves[i]);
+					if (m != back) ExpandNode(m);
+				}
+				stats.peakFrontier = std::max(stats.peakFrontier, open.Size() + inconsistent.size());
+			}
+			return true;
+		};
+
+		auto Trace = [&] {
+			path.clear();
+			path.reserve(nodes[found].depth);
+			for (NodeIndex i = found; nodes[i].parent != none; i = nodes[i].parent)
 			{
-				static const size_t max = i;
-				static const char* inverseSymbols[] = { "", "DOWN", "UP", "RIGHT", "LEFT" };
-				if (max == i)
+				path.push_back(nodes[i].action);
+			}
+			path.reverse();
+		};
+
+		for (;;) {
+			const bool finished = Improve();
+
+			// everything still to look at, each node once
+			std::vector<NodeIndex> left(inconsistent);
+			while (Top()) {
+				left.push_back(open.Next().node);
+				open.Dequeue();
+			}
+			std::sort(left.begin(), left.end());
+			left.erase(std::unique(left.begin(), left.end()), left.end());
+			inconsistent.clear();
+
+			if (found != none) {
+				uint32_t lower = nodes[found].cost;
+				for (NodeIndex i : left)
 				{
-					std::cout << max + (max - depth) + (max % 2 == 0 ? 1 : 0) << ": " << inverseSymbols[action] << std::endl;
+					lower = std::min(lower, nodes[i].cost);
 				}
-				else {
-					std::cout << state << std::endl;
-					if (i != 0)
-						std::cout << max + (max - depth) + (max % 2 == 0 ? 1 : 0) << ": " << inverseSymbols[action] << std::endl;
+				// a pass that finished promises its weight, and the lower bound can do better
+				const double shortest = (lower) ? double(nodes[found].cost) / lower : 1;
+				stats.bound = (finished) ? std::min(weight.Value(), shortest) : shortest;
+				if (nodes[found].depth < published) {
+					published = nodes[found].depth;
+					Trace();
+					Record(true, expandedCount, createdCount, path.size());
+					if (improved) {
+						improved({ stats, path });
+					}
 				}
-				if (parent) {
-					parent->InverseTrace(--i);
+				if (stats.bound <= 1) break;
+			}
+			if (!finished) break;
+			// nothing left means everything reachable was searched
+			if (left.empty()) break;
+
+			weight = strategy.Lower(weight);
+			++pass;
+			for (NodeIndex i : left)
+			{
+				open.Enqueue({i, weight.Key(nodes[i].cost, nodes[i].depth), nodes[i].depth});
+			}
+		}
+
+		const bool solved = found != none;
+		state = nodes[(solved) ? found : current].state;
+		stats.peakExplored = explored.size();
+		stats.bytes = nodes.bytes() + explored.bytes() + closed.capacity() * sizeof(uint32_t)
+					  + stats.peakFrontier * sizeof(PuzzleStrategy::FrontierEntry);
+		if (solved) {
+			Trace();
+		}
+		Record(solved, expandedCount, createdCount, (solved) ? path.size() : nodes[current].depth);
+		return solved;
+	}
+
+	// Both sides keep every node they make, so a child is checked against the other side
+	// as soon as it is generated. The shortest meeting found is only returned once nothing
+	// still undiscovered could be shorter.
+	bool SolveBiDirectional(const PuzzleState& goal, const BiDirectionalSearch& strategy,
+							const CostCalc& valuator, const CostUpdate& update)
+	{
+		using NodeIndex = PuzzleStrategy::NodeIndex;
+		using Entry = PuzzleStrategy::FrontierEntry;
+		static constexpr size_t unsolved = size_t(-1);
+		const NodeIndex none = PuzzleStrategy::SearchNode::none;
+		const bool heuristic = strategy.IsHeuristic();
+
+		// valuator and update only know how to measure towards goal. Measuring back
+		// towards our start through them builds a whole new heuristic for every child, so
+		// that side is guided by Manhattan distance instead, built once for the search.
+		// It is admissible, which is all MM needs of either side.
+		struct Side {
+			const PuzzleState& target;
+			const CostUpdate& update;
+			const ManhattanDistance<N>* towards;
+			Arena nodes;
+			StateTable<PuzzleState, NodeIndex> explored;
+			BucketQueue<Entry> open;
+
+			Side(const PuzzleState& target, const CostUpdate& update, const ManhattanDistance<N>* towards)
+			: target(target), update(update), towards(towards), explored(1 << 16, PuzzleStrategy::SearchNode::none) {}
+
+			int Root(const CostCalc& valuator, const PuzzleState& from) const
+			{
+				return (towards) ? towards->Estimate(from) : valuator(from, target, 0);
+			}
+
+			int Cost(const CostCalc& valuator, const Node& parent, const Node& child, MOVE m) const
+			{
+				if (towards) {
+					return towards->Update(parent.cost + 1, parent.state, m);
+				}
+				return (update) ? update(parent.cost, parent.state, m) : valuator(child.state, target, child.depth);
+			}
+
+			// skips entries left behind when a node was reached again in fewer moves
+			size_t Key()
+			{
+				while (!open.empty() && nodes[open.top().node].depth != open.top().depth) {
+					open.pop();
 				}
+				return (open.empty()) ? size_t(-1) : open.top().cost;
 			}
 		};
 
-		using NodePtr = std::shared_ptr<const Node>;
-		// initialize the frontier with the start state
-		PuzzleStrategy& frontier = strategy; // alias the strategy for easy to follow terminology
-		frontier.Enqueue(std::make_shared<Node>(Node(state)));
-		NodePtr current = frontier.Next<const Node>();
+		// uninformed the costs aren't looked at, so there is no need for a table
+		std::unique_ptr<const ManhattanDistance<N>> towardsStart;
+		if (heuristic) {
+			towardsStart.reset(new ManhattanDistance<N>(state));
+		}
+		const CostUpdate fromScratch;
+		Side forward(goal, update, nullptr), backward(state, fromScratch, towardsStart.get());
+		size_t expandedCount = 0, createdCount = 0;
+		size_t best = unsolved;
+		NodeIndex meetForward = none, meetBackward = none;
+
+		auto Key = [heuristic](const Node& node) {
+			return (heuristic) ? std::max(node.cost, 2 * node.depth) : node.depth;
+		};
 
-		auto hasher=[](const NodePtr& nodeptr){
-			return nodeptr->state.hash();
+		auto Meet = [&](Side& side, NodeIndex index, NodeIndex other, size_t length) {
+			if (length >= best) return;
+			best = length;
+			meetForward = (&side == &forward) ? index : other;
+			meetBackward = (&side == &forward) ? other : index;
 		};
 
-		auto equals=[](const NodePtr& n1, const NodePtr& n2){
-			return *n1 == *n2;
+		auto Seed = [&](Side& side, const PuzzleState& from) {
+			Node root = Root(from);
+			root.cost = side.Root(valuator, from);
+			const NodeIndex index = side.nodes.Allocate(root);
+			side.explored.Insert(from, index);
+			side.open.push({index, Key(root), 0});
+			++createdCount;
+			return index;
 		};
+		const NodeIndex start = Seed(forward, state);
+		const NodeIndex finish = Seed(backward, goal);
+		if (state == goal) {
+			Meet(forward, start, finish, 0);
+		}
 
-		// FIXME: I've no idea what a good size table is
-		std::unordered_set<NodePtr, decltype(hasher), decltype(equals)> explored(1000, hasher, equals);
-		explored.insert(current);
-		size_t expandedCount = 0, createdCount = 1;
+		auto Expand = [&](Side& side, Side& other) {
+			const NodeIndex parent = side.open.top().node;
+			side.open.pop();
+			++expandedCount;
 
-		auto ExpandNode=[&](MOVE direction){
-			using namespace std::placeholders;
-			auto newnode = std::make_shared<const Node>(Node(*current, direction, bind(valuator, _1, goal, current->depth+1)));
-			auto foundit = explored.find(newnode);
-			auto found = (foundit != explored.end()) ? (*foundit).get() : nullptr;
-			if (strategy.TestHeuristics(*newnode, found)) {
-				if (found) {
-					explored.erase(foundit);
+			const auto& moves = Neighbours::cells[side.nodes[parent].state.Blank()];
+			for (size_t i = 0; i < moves.count; ++i)
+			{
+				const MOVE m = static_cast<MOVE>(moves.moves[i]);
+				Node child;
+				const Node& p = side.nodes[parent];
+				if (m == Inverse(p.action)) continue;
+				{
+					SEARCH_TIMER(stats.expansion);
+					MakeChild(p, parent, m, child);
+				}
+				++stats.generated;
+				{
+					SEARCH_TIMER(stats.heuristic);
+					child.cost = side.Cost(valuator, p, child, m);
 				}
-				explored.insert(newnode);
-				frontier.Enqueue(newnode);
-				++createdCount;
-			}
-		};
 
-		// Tried implementing the BiDirectionalSearch in a more efficient way, but I wasted a lot of time trying to 
-		// get it to work as elegantly as the other searches. This is repetitive and inefficient, but it works.
-        if (frontier.IsBiDirectional())
-		{
-            BreadthFirstSearch goalFrontier;
-			std::unordered_set<NodePtr, decltype(hasher), decltype(equals)> goalExplored(1000, hasher, equals);
-			goalFrontier.Enqueue(std::make_shared<Node>(Node(goal)));
-			NodePtr goalCurrent = goalFrontier.Next<const Node>();
-			goalExplored.insert(goalCurrent);
-
-			auto GoalExpandNode = [&](MOVE direction) {
-				using namespace std::placeholders;
-				auto newnode = std::make_shared<const Node>(Node(*goalCurrent, direction, bind(valuator, _1, state, goalCurrent->depth + 1)));
-				auto foundit = goalExplored.find(newnode);
-				auto found = (foundit != goalExplored.end()) ? (*foundit).get() : nullptr;
-				if (strategy.TestHeuristics(*newnode, found)) {
-					if (found) {
-						goalExplored.erase(foundit);
+				SEARCH_TIMER(stats.hashing);
+				NodeIndex index;
+				if (auto found = side.explored.Find(child.state)) {
+					if (side.nodes[*found].depth <= child.depth) {
+						++stats.duplicates;
+						continue;
 					}
-					goalExplored.insert(newnode);
-					goalFrontier.Enqueue(newnode);
+					// reached in fewer moves than before so it has to be looked at again
+					index = *found;
+					side.nodes[index] = child;
+				} else {
+					index = side.nodes.Allocate(child);
+					side.explored.Insert(child.state, index);
 					++createdCount;
 				}
-			};
+				side.open.push({index, Key(child), child.depth});
 
-			while (!frontier.Finished() || !goalFrontier.Finished()) {
-				current = frontier.Next<const Node>();
-				goalCurrent = goalFrontier.Next<const Node>();
-				frontier.Dequeue();
-				goalFrontier.Dequeue();
-
-				if (current->state == goalCurrent->state) break;
-				// Other end conditions: the current node on one direction has been visited on the other direction. 
-                if (explored.find(std::make_shared<const Node>(Node(*goalCurrent))) != explored.end())
-				{
-					// If the current "backwards" node has been visited by the forwards search, set the forward search to that previously visited node.
-                    auto iter = explored.find(std::make_shared<const Node>(Node(*goalCurrent)));
-                    current = *iter;
-                    
-					break;
-				}
-                if (goalExplored.find(std::make_shared<const Node>(Node(*current))) != goalExplored.end())
-				{
-					// If the current forwards node has been visited in the other direction, set the backwards search to that previous node.
-                    auto iter = goalExplored.find(std::make_shared<const Node>(Node(*current)));
-                    goalCurrent = *iter;
-					break;
+				if (auto meet = other.explored.Find(child.state)) {
+					Meet(side, index, *meet, child.depth + other.nodes[*meet].depth);
 				}
+			}
+			stats.peakFrontier = std::max(stats.peakFrontier, forward.open.size() + backward.open.size());
+		};
 
-				expandedCount += 2;
-				ExpandNode(UP);
-				GoalExpandNode(UP);
-				ExpandNode(LEFT);
-				GoalExpandNode(LEFT);
-				ExpandNode(DOWN);
-				GoalExpandNode(DOWN);
-				ExpandNode(RIGHT);
-				GoalExpandNode(RIGHT);
-			}
-
-			// This should the the state where the searches meet unless something went horribly wrong.
-			state = current->state;
-			std::cout << "Search complete: SUCCESS" << std::endl;
-			std::cout << "Nodes expanded:" << expandedCount << std::endl;
-			std::cout << "Nodes created:" << createdCount << std::endl;
-			std::cout << "Total depth of search:" << (current->depth + goalCurrent->depth) << std::endl;
-
-            // Output the path.
-            current->Trace(current->depth);
-            goalCurrent->InverseTrace(goalCurrent->depth);
-
-			// Bidirectional search is guaranteed to find an answer to a solvable puzzle, so this will always return true;
-			return true;
+		Side* layer = nullptr;
+		size_t layerKey = 0;
+		for (;;) {
+			const size_t forwardKey = forward.Key(), backwardKey = backward.Key();
+			// a side that ran dry has seen everything it can reach, so every meeting has been found
+			if (forwardKey == unsolved || backwardKey == unsolved) break;
+
+			// the cheapest any path we haven't found yet could be
+			const size_t bound = (heuristic) ? std::min(forwardKey, backwardKey) : forwardKey + backwardKey + 1;
+			if (best <= bound) break;
+
+			Side* smaller = (forward.open.size() <= backward.open.size()) ? &forward : &backward;
+			if (heuristic) {
+				// MM always expands the lowest priority of either side
+				if (forwardKey != backwardKey) {
+					smaller = (forwardKey < backwardKey) ? &forward : &backward;
+				}
+				layer = smaller;
+			} else if (!layer || layer->Key() != layerKey) {
+				// otherwise a whole layer goes at a time, from the side it is cheaper to grow
+				layer = smaller;
+				layerKey = layer->Key();
+			}
+			Expand(*layer, (layer == &forward) ? backward : forward);
 		}
 
-		while (!frontier.Finished()) {
-			current = frontier.Next<const Node>();
-			frontier.Dequeue();
+		stats.peakExplored = forward.explored.size() + backward.explored.size();
+		stats.bytes = forward.nodes.bytes() + forward.explored.bytes() + backward.nodes.bytes() + backward.explored.bytes()
+					  + stats.peakFrontier * sizeof(Entry);
+		const bool solved = best != unsolved;
+		Record(solved, expandedCount, createdCount, (solved) ? best : 0);
 
-			if (current->state == goal) break;
+		if (solved) {
+			// out from the start to where the sides met, then back along the goal side
+			path.reserve(best);
+			for (NodeIndex i = meetForward; forward.nodes[i].parent != none; i = forward.nodes[i].parent)
+			{
+				path.push_back(forward.nodes[i].action);
+			}
+			path.reverse();
+			for (NodeIndex i = meetBackward; backward.nodes[i].parent != none; i = backward.nodes[i].parent)
+			{
+				path.push_back(Inverse(backward.nodes[i].action));
+			}
+			assert(path.size() == best);
+			Play(path);
+			assert(IsSolved(goal));
+		}
+		return solved;
+	}
 
-			// counterclockwise iteration?
-			++expandedCount;
-			ExpandNode(UP);
-			ExpandNode(LEFT);
-			ExpandNode(DOWN);
-			ExpandNode(RIGHT);
+	// IDA*: one board is shared by the whole search and every move is undone on return.
+	// Only the moves along the current path are remembered, and with a transposition
+	// table as many of the states searched as it has room for.
+	template <class Cost>
+	bool SolveIterativeDeepening(const PuzzleState& goal, DepthLimitedSearch& strategy, const Cost& cost)
+	{
+		static constexpr size_t unbounded = size_t(-1);
+		using Packed = std::integral_constant<bool, (N*N <= 16)>;
+		if (strategy.Table() && !Packed::value) {
+			throw std::logic_error("A transposition table needs a board of 16 cells or fewer");
 		}
+		std::unique_ptr<TranspositionTable> table((strategy.Table()) ? new TranspositionTable(strategy.Table()) : nullptr);
+
+		struct Context {
+			const PuzzleState& goal;
+			const Cost& cost;
+			PuzzleState board;
+			Moves path;
+			size_t bound;
+			size_t next;
+			size_t expandedCount;
+			size_t createdCount;
+			SearchStats& stats;
+			TranspositionTable* table;
+			Puzzle& puzzle;
+			const SearchBudget& budget;
+			size_t checkAt;
+			bool stopped;
+
+			bool Deepen(size_t g, size_t f, MOVE previous)
+			{
+				if (f > bound) {
+					next = std::min(next, f);
+					return false;
+				}
+				if (board == goal) return true;
+				if (table) {
+					SEARCH_TIMER(stats.hashing);
+					if (table->Visit(Pack(board, Packed()), g, bound)) return false;
+				}
+				// a stopped search unwinds the way a solved one does, straight out
+				if (expandedCount >= checkAt && puzzle.Interrupted(budget, expandedCount, bound, path.size(), checkAt)) {
+					stopped = true;
+					return true;
+				}
 
-		// update puzzle to current state (even if not solved)
-		state = current->state;
+				++expandedCount;
+				// counterclockwise, the same as the other searches
+				const size_t from = board.Blank();
+				const auto& moves = Neighbours::cells[from];
+				for (size_t i = 0; i < moves.count; ++i)
+				{
+					const MOVE m = static_cast<MOVE>(moves.moves[i]);
+					// stepping straight back to the parent is never useful
+					if (m == Inverse(previous)) continue;
+					const size_t target = moves.target[m];
+
+					size_t childCost = 0;
+					if (cost.Incremental()) {
+						SEARCH_TIMER(stats.heuristic);
+						childCost = cost.Update(int(f), board, m);
+					}
+					board.Slide(target);
+					path.push_back(m);
+					++createdCount;
+					if (!cost.Incremental()) {
+						SEARCH_TIMER(stats.heuristic);
+						childCost = cost.Score(board, int(g + 1));
+					}
+					if (Deepen(g + 1, childCost, m)) return true;
+					path.pop_back();
+					board.Slide(from);
+				}
+				return false;
+			}
+		} search { goal, cost, state, {}, strategy.Bound(), unbounded, 0, 1, stats, table.get(), *this, strategy.Budget(), 0, false };
+
+		search.path.reserve(strategy.Bound() + 1);
+		bool solved = false;
+		for (;;) {
+			search.next = unbounded;
+			solved = search.Deepen(0, cost.Root(state), NONE) && !search.stopped;
+			if (solved || search.stopped) break;
+
+			// nothing exceeded the bound so there is nothing left to search
+			if (search.next == unbounded) {
+				strategy.Exhaust();
+				break;
+			}
+			if (!strategy.Raise(search.next)) break;
+			search.bound = search.next;
+			if (log) {
+				*log << "Expanding search depth to " << search.bound << std::endl;
+			}
+		}
 
-		bool solved = IsSolved(goal);
-		// FIXME: not sure what "expanded nodes" means
-		std::cout << "Search complete: " << ((solved) ? "SUCCESS" : "FAILURE") << std::endl;
-		std::cout << "Nodes expanded:" << expandedCount << std::endl;
-		std::cout << "Nodes created:" << createdCount << std::endl;
-		std::cout << "Depth of terminated search:" << current->depth << std::endl;
+		// nothing is kept but the board, the current path and the table
+		stats.generated = search.createdCount - 1;
+		stats.bytes = sizeof(search.board) + search.path.bytes();
+		if (table) {
+			stats.duplicates = table->Hits();
+			stats.peakExplored = table->size();
+			stats.bytes += table->bytes();
+		}
+		Record(solved, search.expandedCount, search.createdCount, (solved) ? search.path.size() : search.bound);
 
 		if (solved) {
-			// output the steps--only need the last 40
-			current->Trace(40);
-			return true;
+			path = search.path;
+			Play(path);
+			assert(IsSolved(goal));
 		}
-		return false;
+		return solved;
+	}
+
+	// transposition tables key on the packed board; larger boards never get a table
+	static uint64_t Pack(const PuzzleState& state, std::true_type)
+	{
+		return state.Key();
+	}
+
+	static uint64_t Pack(const PuzzleState&, std::false_type)
+	{
+		return 0;
+	}
+
+	template <class Cost>
+	bool SolveHashDistributed(const PuzzleState& goal, size_t threads, const Cost& cost)
+	{
+		HashDistributedAStar<Puzzle, Cost> search(goal, cost, threads);
+		const auto result = search.Solve(state);
+
+		stats.generated = result.generated;
+		stats.duplicates = result.duplicates;
+		stats.peakFrontier = result.peakFrontier;
+		stats.peakExplored = result.peakExplored;
+		stats.bytes = result.bytes;
+		Record(result.solved, result.expanded, result.created, result.cost);
+		stats.resident = result.resident;
+
+		if (result.solved) {
+			// nothing left open may undercut the answer or it wasn't optimal
+			assert(result.lowerBound >= result.cost);
+			path = result.path;
+			Play(path);
+			assert(IsSolved(goal));
+		}
+		return result.solved;
+	}
+
+	bool SolveLayered(const PuzzleState& goal, const FrontierBreadthFirstSearch& strategy, std::true_type)
+	{
+		LayeredBreadthFirst<Puzzle> search(strategy.Memory(), strategy.Directory());
+		auto result = search.Solve(state, goal);
+
+		stats.generated = result.generated;
+		stats.peakFrontier = result.peakLayer;
+		stats.peakExplored = result.peakStates;
+		stats.bytes = result.bytes;
+		Record(result.solved, result.expanded, result.created, result.depth);
+
+		if (result.solved) {
+			path = std::move(result.path);
+			Play(path);
+			assert(IsSolved(goal));
+		}
+		return result.solved;
+	}
+
+	// layers are runs of packed states and larger boards don't pack into a word
+	bool SolveLayered(const PuzzleState&, const FrontierBreadthFirstSearch&, std::false_type)
+	{
+		throw std::logic_error("Layered search needs a board of 16 cells or fewer");
 	}
 
 	bool IsSolved(const PuzzleState& goal) const
@@ -606,25 +1727,32 @@ public:
 	// great for loading a solved puzzle and scrambling for testing
 	void Scramble(size_t i)
 	{
-		while (i--) {
-			std::random_device rd;     // only used once to initialise (seed) engine
-			std::mt19937 rng(rd());    // random-number engine used (Mersenne-Twister in this case)
-			std::uniform_int_distribution<int> uni(UP, RIGHT); // guaranteed unbiased
+		std::random_device rd;     // only used once to initialise (seed) engine
+		std::mt19937 rng(rd());    // random-number engine used (Mersenne-Twister in this case)
+		Scramble(i, rng);
+	}
 
-			Move(static_cast<MOVE>(uni(rng)));
+	// i random moves drawn from rng. The engine's raw output is used rather than a
+	// distribution since only the engines are specified exactly, so a fixed seed gives
+	// the same puzzle on every standard library; four divides 2^32 so this is unbiased.
+	template <class Rng>
+	void Scramble(size_t i, Rng& rng)
+	{
+		while (i--) {
+			Move(static_cast<MOVE>(UP + rng() % 4));
 		}
 	}
 
-	bool CheckValidMove(MOVE m)
+	bool CheckValidMove(MOVE m) const
 	{
-		return GetMove(m);
+		return GetMove(state.Blank(), m) != npos;
 	}
 
 	bool Move(MOVE m)
 	{
-		char* move = GetMove(m);
-		if (move) {
-			Swap(move);
+		size_t move = GetMove(state.Blank(), m);
+		if (move != npos) {
+			state.Slide(move);
 			return true;
 		}
 		return false;
@@ -652,8 +1780,10 @@ public:
 	
 	friend std::ostream& operator<<(std::ostream& os, const Puzzle<N>& puzzle)
 	{
-		return os << puzzle.state << std::endl;// << puzzle.goal;
+		return os << puzzle.state << '\n';// << puzzle.goal;
 	}
 };
 
+#include "Heuristics.h"
+
 #endif /* Puzzle_h */
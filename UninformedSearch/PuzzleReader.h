@@ -0,0 +1,220 @@
+#ifndef PuzzleReader_h
+#define PuzzleReader_h
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Puzzle.h"
+
+// Reads puzzles one after another from a stream without holding more than one in memory.
+//
+// Text: the tiles of each puzzle in row order, '_' or 0 for the blank, usually one puzzle
+// to a line but any layout works since a puzzle ends once it has all N*N tiles. Anything
+// other than a tile separates tiles and '#' starts a comment that runs to the end of the
+// line. While every tile is a single digit (the 8puzzle) the digits don't need separating.
+//
+// Packed: (N*N + 1)/2 bytes per puzzle, two tiles to a byte with the first in the low
+// nibble, for boards up to 4x4; larger boards take a byte per tile.
+template <size_t N>
+class PuzzleReader {
+public:
+	using PuzzleState = typename Puzzle<N>::PuzzleState;
+	static constexpr size_t size = PuzzleState::size;
+	static_assert(size < 64, "tiles are checked off in a 64 bit mask");
+
+	enum class Format { Text, Packed };
+
+	static constexpr bool nibbles = size <= 16;
+	static constexpr size_t packedBytes = (nibbles) ? (size + 1) / 2 : size;
+
+	explicit PuzzleReader(std::istream& in, Format format = Format::Text)
+	: in(*in.rdbuf()), format(format) {}
+
+	// false at the end of the input; throws if a puzzle is cut short or isn't valid
+	bool Next(PuzzleState& state)
+	{
+		uint64_t seen = 0;
+		const bool found = (format == Format::Text) ? ReadText(state, seen) : ReadPacked(state, seen);
+		if (!found) return false;
+		// with N*N tiles and none repeated this can't happen, but it costs nothing to make sure
+		if (seen != full) {
+			throw std::runtime_error(Where() + " doesn't have every tile from 0 to " + std::to_string(size - 1) + " exactly once");
+		}
+		++count;
+		return true;
+	}
+
+	// puzzles read so far
+	size_t Count() const
+	{
+		return count;
+	}
+
+	static void WritePacked(std::ostream& out, const PuzzleState& state)
+	{
+		char bytes[packedBytes] = {};
+		for (size_t i = 0; i < size; ++i)
+		{
+			if (nibbles) {
+				bytes[i / 2] |= static_cast<char>(state.Get(i) << (4 * (i % 2)));
+			} else {
+				bytes[i] = state.Get(i);
+			}
+		}
+		out.write(bytes, packedBytes);
+	}
+
+private:
+	static constexpr uint64_t full = (uint64_t(1) << size) - 1;
+	// while every tile is one digit a digit is a tile; after that digits run together
+	static constexpr bool digits = size <= 10;
+
+	std::streambuf& in;
+	const Format format;
+	size_t count = 0;
+	size_t line = 1;
+
+	// the puzzle being read, counting from 1
+	std::string Where() const
+	{
+		std::string where = "Puzzle " + std::to_string(count + 1);
+		if (format == Format::Text) {
+			where += " (line " + std::to_string(line) + ")";
+		}
+		return where;
+	}
+
+	// tiles are checked off as they are placed so a repeat is caught the moment it shows up
+	void Place(PuzzleState& state, size_t cell, unsigned tile, uint64_t& seen) const
+	{
+		const uint64_t bit = uint64_t(1) << tile;
+		if (tile >= size || (seen & bit)) {
+			throw std::runtime_error(Where() + " has tile " + std::to_string(tile) + ((tile >= size) ? ", which is too large" : " twice"));
+		}
+		seen |= bit;
+		state.Set(cell, static_cast<char>(tile));
+	}
+
+	bool ReadText(PuzzleState& state, uint64_t& seen)
+	{
+		using Traits = std::streambuf::traits_type;
+		size_t cell = 0;
+		int c = in.sgetc();
+		while (cell < size) {
+			if (Traits::eq_int_type(c, Traits::eof())) {
+				if (cell == 0) return false;
+				throw std::runtime_error(Where() + " ends after " + std::to_string(cell) + " tiles");
+			}
+			if (c == '#') {
+				while (!Traits::eq_int_type(c, Traits::eof()) && c != '\n') {
+					c = in.snextc();
+				}
+				continue;
+			}
+			if (c == '\n') {
+				++line;
+			}
+			if (c == '_') {
+				Place(state, cell++, 0, seen);
+			} else if (c >= '0' && c <= '9') {
+				unsigned tile = unsigned(c - '0');
+				while (!digits) {
+					const int d = in.snextc();
+					if (d < '0' || d > '9') {
+						c = d;
+						break;
+					}
+					// once a tile is too large there is no need to let it keep growing
+					tile = std::min(tile * 10 + unsigned(d - '0'), unsigned(size));
+				}
+				Place(state, cell++, tile, seen);
+				if (!digits) continue;
+			}
+			c = in.snextc();
+		}
+		return true;
+	}
+
+	bool ReadPacked(PuzzleState& state, uint64_t& seen)
+	{
+		unsigned char bytes[packedBytes];
+		const auto got = in.sgetn(reinterpret_cast<char*>(bytes), packedBytes);
+		if (got == 0) return false;
+		if (size_t(got) != packedBytes) {
+			throw std::runtime_error(Where() + " is cut short");
+		}
+		for (size_t i = 0; i < size; ++i)
+		{
+			const unsigned tile = (nibbles) ? (bytes[i / 2] >> (4 * (i % 2))) & 0xF : bytes[i];
+			Place(state, i, tile, seen);
+		}
+		return true;
+	}
+};
+
+// The board size of the text puzzles in in, worked out from the first one: the fewest
+// lines from the top that hold every tile from 0 to n*n - 1 exactly once, read the way
+// PuzzleReader reads them. 0 if no size up to 7x7 fits. in is put back where it was, so
+// it has to be something that can seek, like a file.
+inline size_t PuzzleSize(std::istream& in)
+{
+	const auto start = in.tellg();
+	if (start == std::istream::pos_type(-1)) return 0;
+
+	// whole numbers, and single digits for the sizes small enough to run them together
+	std::vector<unsigned> numbers, digits;
+	auto Fits = [](const std::vector<unsigned>& tiles, size_t n) {
+		if (tiles.size() != n * n) return false;
+		uint64_t seen = 0;
+		for (unsigned tile : tiles)
+		{
+			if (tile >= n * n || (seen >> tile) & 1) return false;
+			seen |= uint64_t(1) << tile;
+		}
+		return true;
+	};
+
+	size_t found = 0;
+	std::string line;
+	while (!found && numbers.size() < 49 && std::getline(in, line)) {
+		line = line.substr(0, line.find('#'));
+		for (size_t i = 0; i < line.size(); ++i)
+		{
+			if (line[i] == '_') {
+				numbers.push_back(0);
+				digits.push_back(0);
+			} else if (std::isdigit(static_cast<unsigned char>(line[i]))) {
+				unsigned number = 0;
+				for (; i < line.size() && std::isdigit(static_cast<unsigned char>(line[i])); ++i)
+				{
+					number = std::min(number * 10 + unsigned(line[i] - '0'), 100u);
+					digits.push_back(unsigned(line[i] - '0'));
+				}
+				numbers.push_back(number);
+				--i;
+			}
+		}
+		for (size_t n = 2; n <= 7 && !found; ++n)
+		{
+			if (Fits(numbers, n) || (n * n <= 10 && Fits(digits, n))) {
+				found = n;
+			}
+		}
+	}
+
+	in.clear();
+	in.seekg(start);
+	return found;
+}
+
+template <size_t N>
+constexpr size_t PuzzleReader<N>::size;
+template <size_t N>
+constexpr size_t PuzzleReader<N>::packedBytes;
+
+#endif /* PuzzleReader_h */
@@ -4,15 +4,25 @@
 
 #include <chrono>
 #include <fstream>
+#include <sstream>
 #include <queue>
 #include <stack>
 #include <string>
 #include <unordered_set>
 #include <memory>
+#include <thread>
 #include <tuple>
 #include <functional>
 
+#include "BatchSolver.h"
+#include "DistributedSearch.h"
+#include "Heuristics.h"
+#include "MoveDatabase.h"
+#include "PageMemory.h"
+#include "PatternDatabase.h"
 #include "Puzzle.h"
+#include "PuzzleReader.h"
+#include "Strategies.h"
 
 #define TEST_ITERATIONS 0
 
@@ -20,126 +30,98 @@ using namespace std;
 
 using Puzzle8 = Puzzle<3>;
 
-bool Puzzle8Search(const Puzzle8::PuzzleState& state, char i, int& row, int& col) {
-	auto beg = begin(state);
-	auto loc = find_if(beg, end(state), bind2nd(equal_to<char>(), i));
-	if (loc != state.end()) {
-		int dist = int(loc - beg);
-		row = dist / state.n;
-		col = dist % state.n;
-		return true;
-	}
-	return false;
-};
+// set when we were started without arguments, as from a double click, so the window
+// stays up until a key is pressed
+static bool interactive = false;
 
-int ManhattanDistance(const Puzzle8::PuzzleState& state, const Puzzle8::PuzzleState& goal, int cumulativeCost)
+void Pause()
 {
-	int distance = 0;
-	// blank tile is not included
-	for (int i = 1; i < state.size; ++i)
-	{
-		int goalRow, goalCol;
-		bool found = Puzzle8Search(goal, i, goalRow, goalCol);
-		assert(found);
-
-		int stateRow, stateCol;
-		found = Puzzle8Search(state, i, stateRow, stateCol);
-		assert(found);
-
-		distance += abs(goalRow - stateRow) + abs(goalCol - stateCol);
+	if (interactive) {
+		cin.ignore();
+		cin.get();
 	}
-	assert(distance >= 0);
-	return distance + cumulativeCost;
-}
-
-int ManhattanDistanceInversions(const Puzzle8::PuzzleState& state, const Puzzle8::PuzzleState& goal, int cumulativeCost)
-{
-	return ManhattanDistance(state, goal, cumulativeCost) + state.Inversions(goal)/2;
 }
 
-int ManhattanDistanceGreedy(const Puzzle8::PuzzleState& state, const Puzzle8::PuzzleState& goal, int cumulativeCost)
+// prints each move of a solution and the board it leaves behind; only the last
+// limit steps are shown since a depth first path can run to thousands of moves
+template <size_t N>
+void PrintPath(ostream& os, const typename Puzzle<N>::PuzzleState& start, const typename Puzzle<N>::Moves& path, size_t limit = 40)
 {
-	// greedy doesnt care about the cost to arrive at this point
-	return ManhattanDistance(state, goal, 0);
-}
-
-int MisplacedTiles(const Puzzle8::PuzzleState& state, const Puzzle8::PuzzleState& goal, int cumulativeCost)
-{
-	int count = 0;
-	// blank tile is not included
-	for (int i = 1; i < state.size; ++i)
+	static const char* symbols[] = {"", "UP","DOWN","LEFT","RIGHT"};
+	Puzzle<N> board(start);
+	os << ((path.size() > limit) ? "Truncated trace route:" : "Path taken to solve:") << '\n';
+	size_t step = 0;
+	for (auto m : path)
 	{
-		int goalRow, goalCol;
-		bool found = Puzzle8Search(goal, i, goalRow, goalCol);
-		assert(found);
-
-		int stateRow, stateCol;
-		found = Puzzle8Search(state, i, stateRow, stateCol);
-		assert(found);
-
-		count += bool(goalRow != stateRow || goalCol != stateCol);
+		board.Move(m);
+		if (++step + limit > path.size()) {
+			os << step << ": " << symbols[m] << '\n' << board.State() << '\n';
+		}
 	}
-	assert(count >= 0 && count < state.size);
-	return count + cumulativeCost;
 }
 
-void AnalyzePuzzle(const Puzzle8& puzzle, const Puzzle8::PuzzleState& goal)
+// runs every strategy on puzzle, or only the one named only
+template <size_t N>
+void AnalyzePuzzle(const Puzzle<N>& puzzle, const typename Puzzle<N>::PuzzleState& goal, const PatternDatabase<N>* pdb = nullptr,
+				   size_t table = defaultTableMegabytes, const string& only = string(),
+				   const SearchBudget& budget = SearchBudget())
 {
 	bool hasSolution = puzzle.HasSolution(goal);
 	if (!hasSolution)
 	{
 		cout << "Puzzle has no solution." << endl;
-		cin.ignore();
-		cin.get();
+		Pause();
 		return;
 	}
 	cout << "Puzzle has a solution." << endl;
-	Puzzle8::CostCalc defaultValue;
-
-	vector<tuple<shared_ptr<PuzzleStrategy>,string,Puzzle8::CostCalc>> strategies {{
-		make_tuple( make_shared<BreadthFirstSearch>(BreadthFirstSearch()), "BreadthFirstSearch", defaultValue),
-		make_tuple( make_shared<DepthFirstSearch>(DepthFirstSearch()), "DepthFirstSearch", defaultValue),
-		// 31 moves is the maximum number needed to solve an 8puzzle so we limit depth to be that
-		make_tuple( make_shared<DepthLimitedSearch>(DepthLimitedSearch(31)), "DepthLimitedSearch", defaultValue),
-		make_tuple( make_shared<IterativeDeepeningSearch>(IterativeDeepeningSearch(1)), "IterativeDeepeningSearch", defaultValue),
-		make_tuple( make_shared<BiDirectionalSearch>(BiDirectionalSearch()), "BiDirectionalSearch", defaultValue),
-		make_tuple( make_shared<QueueStrategy>(QueueStrategy()), "ManhattanDistance", ManhattanDistance),
-		make_tuple( make_shared<QueueStrategy>(QueueStrategy()), "ManhattanDistanceInversions", ManhattanDistanceInversions),
-		make_tuple( make_shared<QueueStrategy>(QueueStrategy()), "ManhattanDistanceGreedy", ManhattanDistanceGreedy),
-		make_tuple( make_shared<QueueStrategy>(QueueStrategy()), "MisplacedTiles", MisplacedTiles)
-	}};
 
     cout << "Attempting to solve puzzle:" << endl << puzzle << endl;
-	for (auto& package : strategies) {
-		shared_ptr<PuzzleStrategy> strategy;
+	bool any = false;
+	for (auto& package : Strategies<N>(goal, pdb, table)) {
+		StrategyFactory factory;
 		string message;
-		Puzzle8::CostCalc valuator;
+		typename Puzzle<N>::CostCalc valuator;
+		typename Puzzle<N>::CostUpdate update;
 
-		tie(strategy, message, valuator) = package;
+		tie(factory, message, valuator, update, ignore) = package;
+		if (!only.empty() && message != only) continue;
+		any = true;
+		auto strategy = Limited(factory, budget)();
 
-		shared_ptr<Puzzle8> puzzleCopy;
+		shared_ptr<Puzzle<N>> puzzleCopy;
 		
 		cout << "\nAttempting to solve with " << message << endl;
-		cout << "Beginning timer" << endl;
-		chrono::steady_clock::time_point begin = chrono::steady_clock::now();
 
-		bool solved = false;
+		typename Puzzle<N>::Solution solution;
+		// every attempt is timed by the search itself so the trace output doesn't count
+		SearchStats::Duration searching{0};
 		do {
 			// copy the puzzle so we can attempt to solve it multiple times
 			// and use multiple different methods
-			puzzleCopy = make_shared<Puzzle8>(puzzle);
+			puzzleCopy = make_shared<Puzzle<N>>(puzzle);
+			puzzleCopy->SetImprovement([](const typename Puzzle<N>::Solution& better) {
+				cout << "Found a path of " << better.path.size() << " moves, at most " << better.stats.bound
+					 << " times the shortest" << endl;
+			});
 			if (valuator) {
-				solved = puzzleCopy->Solve(goal, *strategy, valuator);
+				solution = puzzleCopy->Solve(goal, *strategy, valuator, update);
 			} else {
-				solved = puzzleCopy->Solve(goal, *strategy);
+				solution = puzzleCopy->Solve(goal, *strategy);
 			}
-		} while (!solved && strategy->ExpandSearch());
+			searching += solution.stats.elapsed;
+		} while (!solution && !solution.stats.stopped && strategy->ExpandSearch());
 
-		cout << "Finished: stopping timer." << endl;
-		chrono::steady_clock::time_point end = chrono::steady_clock::now();
-		cout << "Time taken: " << chrono::duration_cast<chrono::milliseconds>(end - begin).count() << "ms" << endl;
+		cout << "Search complete: " << ((solution) ? "SUCCESS" : "FAILURE") << '\n';
+		cout << "Statistics: " << solution.stats << '\n';
+		if (solution) {
+			PrintPath<N>(cout, puzzle.State(), solution.path);
+		}
+		cout << "Time taken: " << chrono::duration_cast<chrono::milliseconds>(searching).count() << "ms" << endl;
 
-		assert(solved == hasSolution);
+		assert(solution.stats.solved == hasSolution || solution.stats.stopped);
+	}
+	if (!any) {
+		cout << "There is no strategy named " << only << endl;
 	}
 }
 
@@ -149,88 +131,510 @@ void Tests(const Puzzle8::PuzzleState& goal)
 	testPuzzle.Scramble(100);
 	assert(testPuzzle.HasSolution(goal));
 
-	AnalyzePuzzle(testPuzzle, goal);
+	AnalyzePuzzle<3>(testPuzzle, goal);
+}
+
+// Whatever state of a layer fills the buffer, the spill has to come back with the whole
+// 8puzzle space. Run files go in directory.
+void TestLayeredSpill(const string& directory)
+{
+	for (size_t chunk = 1024; chunk < 1280; ++chunk)
+	{
+		LayeredBreadthFirst<Puzzle8> search(chunk * 2 * sizeof(uint64_t), directory);
+		const auto result = search.Enumerate(OrderedGoal<3>());
+		assert(result.created == 181440 && result.depth == 31);
+	}
+}
+
+struct Options {
+	string batch;
+	// for a batch ManhattanDistance if not given; a single puzzle is tried with them all
+	string strategy;
+	string pdb;
+	string pack;
+	string spill;
+	// a move database (see --generate-moves) to answer 8puzzles from instead of searching
+	string lookup;
+	// entries in the batch's solution cache, and a file it is kept in between runs
+	size_t cache = 0;
+	string cacheFile;
+	size_t memory = 0;
+	size_t table = defaultTableMegabytes;
+	size_t enumerate = 0;
+	// 0 works it out from the input
+	size_t size = 0;
+	size_t threads = thread::hardware_concurrency();
+	bool packed = false;
+	// --nodes and --deadline (milliseconds) stop every search that keeps to a budget
+	SearchBudget budget;
+	// --pages <normal|huge|gigantic> and --numa <on|off> (see PageMemory.h)
+	PageMemory::Settings memoryPages;
+	// --cluster host:port,... and --rank <i> share --enumerate out across machines
+	vector<string> cluster;
+	size_t rank = 0;
+};
+
+// how much of what the searches mapped got the pages asked for
+void PrintPages()
+{
+	if (PageMemory::Current().pages == PageMemory::NORMAL_PAGES) return;
+	cout << "Mapped " << PageMemory::Mapped(PageMemory::GIGANTIC_PAGES) << " bytes in gigantic pages, "
+		 << PageMemory::Mapped(PageMemory::HUGE_PAGES) << " in huge pages and "
+		 << PageMemory::Mapped(PageMemory::NORMAL_PAGES) << " in normal pages" << endl;
+}
+
+// --batch <file|->: streams puzzles from the file (or stdin) into one strategy across
+// every core, printing each result as soon as everything before it is done. With --pack
+// the puzzles are only checked and written back out in the packed format. --table <MB>
+// sizes the transposition table of the depth first searches that keep one. --deadline
+// <ms> and --nodes <count> hold each puzzle to a budget; the anytime searches give the
+// best path they had by then. --cache <entries> answers starts the batch has solved
+// before, and their mirror images, without searching; --cache-file <file> keeps them
+// across runs. --pages huge or gigantic maps the searches' big tables in large pages
+// where the system has them, and --numa on keeps the hash distributed threads and
+// their tables on one node each.
+template <size_t N>
+int BatchPuzzles(const Options& options)
+{
+	using Reader = PuzzleReader<N>;
+	ifstream file;
+	istream* in = &cin;
+	if (options.batch != "-") {
+		file.open(options.batch, ios::binary);
+		if (!file)
+		{
+			cout << "The file was not found or could not be opened." << endl;
+			return 1;
+		}
+		in = &file;
+	}
+	Reader reader(*in, (options.packed) ? Reader::Format::Packed : Reader::Format::Text);
+	typename Puzzle<N>::PuzzleState state;
+
+	if (!options.pack.empty()) {
+		ofstream out(options.pack, ios::binary);
+		while (reader.Next(state)) {
+			Reader::WritePacked(out, state);
+		}
+		if (!out.flush())
+		{
+			cout << "Could not write " << options.pack << endl;
+			return 1;
+		}
+		cout << "Packed " << reader.Count() << " puzzles into " << options.pack << endl;
+		return 0;
+	}
+
+	const auto goal = OrderedGoal<N>();
+	unique_ptr<PatternDatabase<N>> pdb;
+	if (!options.pdb.empty()) {
+		pdb.reset(new PatternDatabase<N>(options.pdb));
+	}
+	const string name = (options.strategy.empty()) ? "ManhattanDistance" : options.strategy;
+	for (auto& package : Strategies<N>(goal, pdb.get(), options.table)) {
+		if (get<1>(package) != name) continue;
+
+		BatchSolver<N> solver(goal, Limited(get<0>(package), options.budget), get<2>(package), get<3>(package), options.threads);
+		cout << "Solving puzzles with " << name << " on " << solver.Threads() << " threads" << endl;
+
+		unique_ptr<SolutionCache<N>> cache;
+		if (options.cache || !options.cacheFile.empty()) {
+			cache.reset(new SolutionCache<N>(goal, (options.cache) ? options.cache : size_t(1) << 20));
+			if (!options.cacheFile.empty()) {
+				const size_t loaded = cache->Load(options.cacheFile);
+				cout << "Loaded " << loaded << " cached solutions" << endl;
+			}
+			solver.SetCache(cache.get(), get<4>(package));
+		}
+
+		chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+		size_t solvedCount = 0;
+		const size_t count = solver.Solve([&](typename Puzzle<N>::PuzzleState& start) {
+			return reader.Next(start);
+		}, [&](size_t i, typename BatchSolver<N>::Result& result) {
+			const auto& stats = result.stats;
+			solvedCount += stats.solved;
+			cout << i << ": " << ((stats.solved) ? "SUCCESS" : "FAILURE") << " " << stats << '\n';
+		});
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+		cout << "Solved " << solvedCount << " of " << count << endl;
+		cout << "Time taken: " << chrono::duration_cast<chrono::milliseconds>(end - begin).count() << "ms" << endl;
+		PrintPages();
+		if (cache) {
+			const auto counters = cache->Counters();
+			cout << "Batch " << solver.Counters() << endl;
+			cout << "Cache entries " << counters.entries << " evictions " << counters.evictions
+				 << " symmetries " << cache->Symmetries() << endl;
+			if (!options.cacheFile.empty()) {
+				cache->Save(options.cacheFile);
+			}
+		}
+		return 0;
+	}
+	cout << "There is no strategy named " << name << endl;
+	return 1;
+}
+
+// --lookup <file>: every 8puzzle of the batch, or the one puzzle given, answered from a
+// move database with no search at all
+int LookupPuzzles(const Options& options, const string& file_name)
+{
+	using Reader = PuzzleReader<3>;
+	const MoveDatabase<3> moves(options.lookup);
+	if (!(moves.Goal() == OrderedGoal<3>())) {
+		cout << options.lookup << " was built for a different goal" << endl;
+		return 1;
+	}
+	const string& source = (options.batch.empty()) ? file_name : options.batch;
+	ifstream file;
+	istream* in = &cin;
+	if (source != "-") {
+		file.open(source, ios::binary);
+		if (!file)
+		{
+			cout << "The file was not found or could not be opened." << endl;
+			return 1;
+		}
+		in = &file;
+	}
+	Reader reader(*in, (options.packed) ? Reader::Format::Packed : Reader::Format::Text);
+
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	Puzzle8::PuzzleState state;
+	size_t solvedCount = 0;
+	while (reader.Next(state)) {
+		const auto solution = moves.Solve(state);
+		solvedCount += solution.stats.solved;
+		cout << reader.Count() - 1 << ": " << ((solution) ? "SUCCESS" : "FAILURE") << " " << solution.stats << '\n';
+		if (options.batch.empty() && solution) {
+			PrintPath<3>(cout, state, solution.path);
+		}
+	}
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+	cout << "Solved " << solvedCount << " of " << reader.Count() << endl;
+	cout << "Time taken: " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << "us" << endl;
+	return 0;
+}
+
+// the batch's size is --size or else that of its first puzzle; stdin and packed files
+// can't be read ahead of, so they are 8puzzles unless told otherwise
+size_t BatchSize(const Options& options)
+{
+	if (options.size || options.batch == "-" || options.packed) {
+		return (options.size) ? options.size : 3;
+	}
+	ifstream file(options.batch, ios::binary);
+	const size_t size = PuzzleSize(file);
+	// one that can't be worked out is read as an 8puzzle, which says what is wrong with it
+	return (size) ? size : 3;
 }
 
-int main()
+// Solves the first puzzle in in. Every strategy is tried on the small boards, but on the
+// larger ones the uninformed searches would never finish so only --strategy is, by
+// default IDA* with linear conflicts.
+template <size_t N>
+int AnalyzeFile(istream& in, const Options& options)
 {
-	Puzzle8::PuzzleState goal {{
-		{ 1, 2, 3 },
-		{ 4, 5, 6 },
-		{ 7, 8, 0 }
-	}};
+	typename Puzzle<N>::PuzzleState state;
+	try {
+		PuzzleReader<N> reader(in);
+		if (!reader.Next(state)) {
+			throw runtime_error("The file has no puzzle in it");
+		}
+	} catch (const exception& e) {
+		cout << "The inputted puzzle was not valid. " << e.what() << endl;
+		Pause();
+		return 1;
+	}
+
+	unique_ptr<PatternDatabase<N>> pdb;
+	if (!options.pdb.empty()) {
+		pdb.reset(new PatternDatabase<N>(options.pdb));
+	}
+	const string only = (options.strategy.empty() && N > 3) ? "IterativeDeepeningLinearConflict" : options.strategy;
+	AnalyzePuzzle<N>(Puzzle<N>(state), OrderedGoal<N>(), pdb.get(), options.table, only, options.budget);
+	return 0;
+}
+
+// every node of the cluster runs this with its own --rank; the first prints the layers
+template <size_t N>
+int EnumerateDistributed(const Options& options)
+{
+	DistributedBreadthFirst<Puzzle<N>> search(options.cluster, options.rank);
+	const bool first = (search.Rank() == 0);
+	const auto result = search.Enumerate(OrderedGoal<N>(), [first](size_t depth, size_t states) {
+		if (first) {
+			cout << depth << ": " << states << endl;
+		}
+	});
+	const double seconds = chrono::duration<double>(result.elapsed).count();
+
+	if (first) {
+		size_t states = 0;
+		for (size_t layer : result.layers)
+		{
+			states += layer;
+		}
+		cout << "States: " << states << " radius: " << result.depth << endl;
+	}
+	cout << "Node " << search.Rank() << " of " << search.Nodes() << ": owned " << result.owned << " expanded "
+		 << result.expanded << " (" << static_cast<size_t>(result.expanded / max(seconds, 1e-9)) << " nodes/s) peak states "
+		 << result.peakStates << " sent " << result.sent << " states in " << result.messages << " messages, "
+		 << result.bytesSent << " bytes (" << 100.0 * result.bytesSent / max<size_t>(result.sent * sizeof(uint64_t), 1)
+		 << "% of raw) received " << result.bytesReceived << " bytes" << endl;
+	cout << "Time taken: " << chrono::duration_cast<chrono::milliseconds>(result.elapsed).count() << "ms" << endl;
+	return 0;
+}
+
+// --enumerate <2|3|4> [--memory <MB>] [--spill <directory>]: every state reachable from
+// the ordered goal, a layer at a time, without a closed list. With --cluster the layers
+// are split among the machines listed instead (see DistributedSearch.h).
+template <size_t N>
+int EnumerateStates(const Options& options)
+{
+	if (!options.cluster.empty()) {
+		return EnumerateDistributed<N>(options);
+	}
+	LayeredBreadthFirst<Puzzle<N>> search(options.memory << 20, options.spill);
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	const auto result = search.Enumerate(OrderedGoal<N>(), [](size_t depth, size_t states) {
+		cout << depth << ": " << states << endl;
+	});
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+	cout << "States: " << result.created << " radius: " << result.depth << " peak layer: " << result.peakLayer
+		 << " peak memory: " << result.bytes << " bytes spilled: " << result.spilled << endl;
+	cout << "Time taken: " << chrono::duration_cast<chrono::milliseconds>(end - begin).count() << "ms" << endl;
+	return 0;
+}
+
+// --generate-pdb <3|4> <file> <group>... where each group is a comma separated list of tiles;
+// a 15puzzle group can have up to 7 (see PatternDatabase.h)
+template <size_t N>
+int GeneratePatternDatabase(const vector<string>& args)
+{
+	vector<typename PatternDatabase<N>::Group> groups;
+	for (size_t i = 3; i < args.size(); ++i)
+	{
+		typename PatternDatabase<N>::Group group;
+		stringstream tiles(args[i]);
+		string tile;
+		while (getline(tiles, tile, ',')) {
+			group.push_back(static_cast<char>(stoi(tile)));
+		}
+		groups.push_back(group);
+	}
+
+	cout << "Generating pattern database " << args[2] << endl;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	PatternDatabase<N>::Generate(OrderedGoal<N>(), groups, args[2]);
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	cout << "Time taken: " << chrono::duration_cast<chrono::milliseconds>(end - begin).count() << "ms" << endl;
+	return 0;
+}
+
+// --generate-moves <file>: the best move from every 8puzzle state, for --lookup
+int GenerateMoveDatabase(const string& path)
+{
+	cout << "Generating move database " << path << endl;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	const size_t radius = MoveDatabase<3>::Generate(OrderedGoal<3>(), path);
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	cout << "Radius: " << radius << endl;
+	cout << "Time taken: " << chrono::duration_cast<chrono::milliseconds>(end - begin).count() << "ms" << endl;
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	const vector<string> args(argv + 1, argv + argc);
+	Options options;
+	string file_name;
+	try {
+		if (args.size() >= 4 && args[0] == "--generate-pdb") {
+			return (args[1] == "4") ? GeneratePatternDatabase<4>(args) : GeneratePatternDatabase<3>(args);
+		}
+		if (args.size() >= 2 && args[0] == "--generate-moves") {
+			return GenerateMoveDatabase(args[1]);
+		}
+		for (size_t i = 0; i < args.size(); ++i)
+		{
+			// anything that isn't an option is the puzzle to solve
+			if (args[i].compare(0, 2, "--") != 0) {
+				file_name = args[i];
+				continue;
+			}
+			if (i + 1 == args.size()) {
+				cout << "Option " << args[i] << " needs a value" << endl;
+				return 1;
+			}
+			const string& value = args[++i];
+			if (args[i - 1] == "--pdb") {
+				options.pdb = value;
+			} else if (args[i - 1] == "--batch") {
+				options.batch = value;
+			} else if (args[i - 1] == "--strategy") {
+				options.strategy = value;
+			} else if (args[i - 1] == "--threads") {
+				options.threads = stoul(value);
+			} else if (args[i - 1] == "--size") {
+				options.size = stoul(value);
+			} else if (args[i - 1] == "--format") {
+				options.packed = (value == "packed");
+			} else if (args[i - 1] == "--pack") {
+				options.pack = value;
+			} else if (args[i - 1] == "--enumerate") {
+				options.enumerate = stoul(value);
+			} else if (args[i - 1] == "--memory") {
+				options.memory = stoul(value);
+			} else if (args[i - 1] == "--spill") {
+				options.spill = value;
+			} else if (args[i - 1] == "--table") {
+				options.table = stoul(value);
+			} else if (args[i - 1] == "--lookup") {
+				options.lookup = value;
+			} else if (args[i - 1] == "--cache") {
+				options.cache = stoul(value);
+			} else if (args[i - 1] == "--cache-file") {
+				options.cacheFile = value;
+			} else if (args[i - 1] == "--nodes") {
+				options.budget.nodes = stoul(value);
+			} else if (args[i - 1] == "--deadline") {
+				options.budget.time = chrono::milliseconds(stoul(value));
+			} else if (args[i - 1] == "--pages") {
+				if (value == "normal") {
+					options.memoryPages.pages = PageMemory::NORMAL_PAGES;
+				} else if (value == "huge") {
+					options.memoryPages.pages = PageMemory::HUGE_PAGES;
+				} else if (value == "gigantic") {
+					options.memoryPages.pages = PageMemory::GIGANTIC_PAGES;
+				} else {
+					cout << "Pages are normal, huge or gigantic" << endl;
+					return 1;
+				}
+			} else if (args[i - 1] == "--numa") {
+				options.memoryPages.numa = (value == "on");
+			} else if (args[i - 1] == "--cluster") {
+				stringstream peers(value);
+				string peer;
+				while (getline(peers, peer, ',')) {
+					options.cluster.push_back(peer);
+				}
+			} else if (args[i - 1] == "--rank") {
+				options.rank = stoul(value);
+			} else {
+				cout << "Unknown option " << args[i - 1] << endl;
+				return 1;
+			}
+		}
+		// before anything is searched, so every table is mapped the one way
+		PageMemory::Configure(options.memoryPages);
+		if (options.enumerate) {
+			switch (options.enumerate) {
+				case 2:
+					return EnumerateStates<2>(options);
+				case 3:
+					return EnumerateStates<3>(options);
+				case 4:
+					return EnumerateStates<4>(options);
+				default:
+					cout << "Only boards of up to 16 cells can be enumerated" << endl;
+					return 1;
+			}
+		}
+		if (!options.lookup.empty() && (!options.batch.empty() || !file_name.empty())) {
+			ios::sync_with_stdio(false);
+			return LookupPuzzles(options, file_name);
+		}
+		if (!options.batch.empty()) {
+			ios::sync_with_stdio(false);
+			switch (BatchSize(options)) {
+				case 2:
+					return BatchPuzzles<2>(options);
+				case 3:
+					return BatchPuzzles<3>(options);
+				case 4:
+					return BatchPuzzles<4>(options);
+				case 5:
+					return BatchPuzzles<5>(options);
+				default:
+					cout << "Only boards from 2x2 to 5x5 can be solved" << endl;
+					return 1;
+			}
+		}
+	} catch (const exception& e) {
+		cout << e.what() << endl;
+		return 1;
+	}
 #if TEST_ITERATIONS
+	const auto goal = OrderedGoal<3>();
 	cout << "Running tests with goal:" << endl << goal << endl;
+	TestLayeredSpill(".");
 
 	int i = TEST_ITERATIONS;
 	while (i--) {
 		Tests(goal);
 	}
 #else
-	string file_name = "";
-	cout << "Enter a file name to read a puzzle from." << endl;
-	if (!(cin >> file_name))
-	{
-		cout << "\nThe file name was invalid." << endl;
-		cin.ignore();
-		cin.get();
-		return 1;
+	// with no puzzle on the command line we ask for one, and keep the console open at the end
+	interactive = file_name.empty();
+	if (interactive) {
+		cout << "Enter a file name to read a puzzle from." << endl;
+		if (!(cin >> file_name))
+		{
+			cout << "\nThe file name was invalid." << endl;
+			Pause();
+			return 1;
+		}
 	}
 
 	ifstream in(file_name);
 	if (!in)
 	{
 		cout << "The file was not found or could not be opened." << endl;
-		cin.ignore();
-		cin.get();
+		Pause();
 		return 1;
 	}
 
-	Puzzle8::PuzzleState state;
-	auto size = state.n;
-    // Use this int with a "bitmask"
-    int flags = 0;
-    
-	// The location of the zero (i.e. empty) tile.
-    int zero[2] = {-1, -1};
-	int count = 0;
-	while (in && count <= 8)
-	{
-		char temp = '\0';
-		if (in >> temp)
-		{
-			if (temp == '_')
-			{
-				state[count / size][count % size] = 0;
-				zero[0] = count / size;
-				zero[1] = count++ % size;
-			}
-			else
-			{
-				state[count / size][count % size] = temp - '0';
-                // Use 2^(value - 1) as a bitmask of sorts to make sure all values have been entered and
-                // they are all valid (e.g. 1-8).
-                flags += pow(2, ( (temp - '0') - 1) );
-				++count;
-			}
+	// the board's size is read off the puzzle itself unless --size gives it
+	size_t size = (options.size) ? options.size : PuzzleSize(in);
+	if (!size) {
+		// read as an 8puzzle so the reader says what is wrong with it
+		size = 3;
+	}
+	int result = 1;
+	try {
+		switch (size) {
+			case 2:
+				result = AnalyzeFile<2>(in, options);
+				break;
+			case 3:
+				result = AnalyzeFile<3>(in, options);
+				break;
+			case 4:
+				result = AnalyzeFile<4>(in, options);
+				break;
+			case 5:
+				result = AnalyzeFile<5>(in, options);
+				break;
+			default:
+				cout << "Only boards from 2x2 to 5x5 can be solved" << endl;
+				Pause();
+				return 1;
 		}
-	};
-    // Check that the puzzle has all needed values
-    if( !(flags == 255 && zero[0] >= 0) )
-    {
-        cout << "The inputted puzzle was not valid. Puzzle was:" << endl;
-        cout << state << endl;
-		cin.ignore();
-        cin.get();
-        return 1;
-    }
-
-	Puzzle8 puzzle(state);
-	AnalyzePuzzle(puzzle, goal);
+	} catch (const exception& e) {
+		cout << e.what() << endl;
+		Pause();
+		return 1;
+	}
+	if (result) {
+		return result;
+	}
 #endif
 
-    cout << "All searches are finished.";
-	cin.ignore();
-	cin.get();
+	cout << "All searches are finished." << endl;
+	Pause();
 	return 0;
 }
@@ -0,0 +1,175 @@
+#ifndef SearchStats_h
+#define SearchStats_h
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+
+// Per phase timers cost a clock read or two per child, so they are only built in
+// when SEARCH_PROFILE is nonzero. It defaults to on for the debug configurations
+// (Xcode defines DEBUG, MSVC's debug runtime _DEBUG) and off everywhere else, where
+// SEARCH_TIMER expands to nothing.
+#ifndef SEARCH_PROFILE
+#if defined(DEBUG) || defined(_DEBUG)
+#define SEARCH_PROFILE 1
+#else
+#define SEARCH_PROFILE 0
+#endif
+#endif
+
+// what a search did, kept by the puzzle after each Solve
+struct SearchStats {
+	using Duration = std::chrono::steady_clock::duration;
+
+	bool solved = false;
+	size_t expanded = 0;
+	// every child made, created or not
+	size_t generated = 0;
+	// children thrown away because their state had already been seen
+	size_t duplicates = 0;
+	// states reached again by a better way and updated where they were
+	size_t reopened = 0;
+	// nodes kept by the search
+	size_t created = 0;
+	size_t depth = 0;
+	// the budget ran out before the search was done; what it found by then still stands
+	bool stopped = false;
+	// for the weighted searches the path is at most this many times the shortest, so
+	// long as the heuristic is admissible. 0 when no bound was worked out
+	double bound = 0;
+	// answered from a solution cache rather than searched
+	bool cached = false;
+
+	size_t peakFrontier = 0;
+	size_t peakExplored = 0;
+	// what the search's own containers held at their largest
+	size_t bytes = 0;
+	// what the whole process held in memory as the search finished, its containers
+	// not yet released. 0 where it isn't known
+	size_t resident = 0;
+
+	// the search alone, none of the logging that follows it
+	Duration elapsed{0};
+	// only measured when SEARCH_PROFILE is on
+	Duration heuristic{0};
+	Duration expansion{0};
+	Duration hashing{0};
+
+	explicit operator bool() const
+	{
+		return solved;
+	}
+
+	double NodesPerSecond() const
+	{
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+		return (seconds > 0) ? expanded / seconds : 0;
+	}
+
+	friend std::ostream& operator<<(std::ostream& os, const SearchStats& stats)
+	{
+		using std::chrono::microseconds;
+		using std::chrono::duration_cast;
+		os << "expanded " << stats.expanded << " generated " << stats.generated
+		   << " duplicates " << stats.duplicates << " reopened " << stats.reopened
+		   << " created " << stats.created
+		   << " depth " << stats.depth << " peak frontier " << stats.peakFrontier
+		   << " peak explored " << stats.peakExplored << " bytes " << stats.bytes;
+		if (stats.resident) {
+			os << " resident " << stats.resident;
+		}
+		os << " time " << duration_cast<microseconds>(stats.elapsed).count() << "us"
+		   << " nodes/s " << static_cast<size_t>(stats.NodesPerSecond());
+		if (stats.bound) {
+			os << " bound " << stats.bound;
+		}
+		if (stats.stopped) {
+			os << " stopped";
+		}
+		if (stats.cached) {
+			os << " cached";
+		}
+#if SEARCH_PROFILE
+		os << " heuristic " << duration_cast<microseconds>(stats.heuristic).count() << "us"
+		   << " expansion " << duration_cast<microseconds>(stats.expansion).count() << "us"
+		   << " hashing " << duration_cast<microseconds>(stats.hashing).count() << "us";
+#endif
+		return os;
+	}
+};
+
+// Lets a search be stopped from another thread. Copies share the one flag, so the
+// caller keeps a copy and the search another.
+class CancellationToken {
+public:
+	CancellationToken()
+	: flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+	void Cancel()
+	{
+		flag->store(true, std::memory_order_relaxed);
+	}
+
+	bool Cancelled() const
+	{
+		return flag->load(std::memory_order_relaxed);
+	}
+
+private:
+	std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// what a search reports as it goes: bound is the f of what it is expanding (the
+// iteration's bound for IDA*) and frontier what it has waiting, or its path for IDA*
+struct SearchProgress {
+	size_t expanded;
+	size_t bound;
+	size_t frontier;
+	SearchStats::Duration elapsed;
+};
+
+// How far a search may go before it gives up: a number of nodes expanded, a time from
+// when it started or being cancelled, whichever comes first. Zero is no limit.
+struct SearchBudget {
+	using Clock = std::chrono::steady_clock;
+
+	// searches look up from their work this often, in expansions
+	static constexpr size_t interval = 1024;
+
+	size_t nodes = 0;
+	Clock::duration time{0};
+	CancellationToken cancel;
+
+	bool Spent(size_t expanded, Clock::duration elapsed) const
+	{
+		return (nodes && expanded >= nodes) || (time.count() && elapsed >= time) || cancel.Cancelled();
+	}
+};
+
+#if SEARCH_PROFILE
+// adds the time until the end of the enclosing scope to a SearchStats duration
+class SearchTimer {
+public:
+	explicit SearchTimer(SearchStats::Duration& total)
+	: total(total), begin(std::chrono::steady_clock::now()) {}
+
+	~SearchTimer()
+	{
+		total += std::chrono::steady_clock::now() - begin;
+	}
+
+private:
+	SearchStats::Duration& total;
+	const std::chrono::steady_clock::time_point begin;
+};
+
+#define SEARCH_TIMER_NAME(line) searchTimer##line
+#define SEARCH_TIMER_AT(total, line) SearchTimer SEARCH_TIMER_NAME(line)(total)
+#define SEARCH_TIMER(total) SEARCH_TIMER_AT(total, __LINE__)
+#else
+#define SEARCH_TIMER(total)
+#endif
+
+#endif /* SearchStats_h */
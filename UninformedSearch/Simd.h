@@ -0,0 +1,92 @@
+#ifndef Simd_h
+#define Simd_h
+
+#include <cstdint>
+
+// Vector kernels for boards packed a nibble per tile into one word, picked at run time
+// so one binary still runs on machines without the instructions. Only x86 has them for
+// now; everywhere else Supported() is false and callers stay on their scalar loops.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+// lets the kernel use SSSE3 without building the whole program for it
+#define SIMD_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define SIMD_TARGET_SSSE3
+#endif
+
+namespace Simd {
+	// pshufb is SSSE3
+	inline bool Supported()
+	{
+#if SIMD_X86 && defined(_MSC_VER)
+		static const bool ssse3 = [] {
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 9)) != 0;
+		}();
+		return ssse3;
+#elif SIMD_X86
+		static const bool ssse3 = [] {
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("ssse3") != 0;
+		}();
+		return ssse3;
+#else
+		return false;
+#endif
+	}
+
+	// What ManhattanDistance needs to score a whole board at once: the goal row and
+	// column of every tile, and the row and column of every cell, one byte apiece.
+	// Tiles and cells past the end of the board are left zero.
+	struct ManhattanTables {
+		uint8_t tileRow[16];
+		uint8_t tileCol[16];
+		uint8_t cellRow[16];
+		uint8_t cellCol[16];
+	};
+
+#if SIMD_X86
+	// Spreads the sixteen nibbles of the board over the lanes of a register, looks up
+	// every tile's home with a shuffle and adds the distances up with one psadbw.
+	// The blank and any cells past the end of the board hold tile 0, which is masked off.
+	SIMD_TARGET_SSSE3 inline int Manhattan(uint64_t board, const ManhattanTables& tables)
+	{
+		const __m128i nibble = _mm_set1_epi8(0x0F);
+		const __m128i word = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&board));
+		const __m128i even = _mm_and_si128(word, nibble);
+		const __m128i odd = _mm_and_si128(_mm_srli_epi16(word, 4), nibble);
+		const __m128i tiles = _mm_unpacklo_epi8(even, odd);
+
+		const __m128i homeRow = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.tileRow)), tiles);
+		const __m128i homeCol = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.tileCol)), tiles);
+		const __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.cellRow));
+		const __m128i col = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.cellCol));
+
+		// |a - b| on unsigned bytes is max - min
+		const __m128i rows = _mm_sub_epi8(_mm_max_epu8(homeRow, row), _mm_min_epu8(homeRow, row));
+		const __m128i cols = _mm_sub_epi8(_mm_max_epu8(homeCol, col), _mm_min_epu8(homeCol, col));
+		const __m128i blank = _mm_cmpeq_epi8(tiles, _mm_setzero_si128());
+		const __m128i distance = _mm_andnot_si128(blank, _mm_add_epi8(rows, cols));
+
+		const __m128i sums = _mm_sad_epu8(distance, _mm_setzero_si128());
+		return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+	}
+#else
+	inline int Manhattan(uint64_t, const ManhattanTables&)
+	{
+		return 0;
+	}
+#endif
+}
+
+#endif /* Simd_h */
@@ -0,0 +1,239 @@
+#ifndef Socket_h
+#define Socket_h
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+// A TCP connection, or a socket listening for them, closed when it goes out of scope.
+// Sends and receives move whole buffers or throw, so callers don't deal in partial
+// reads and writes. Only what the distributed search needs is here.
+class Socket {
+public:
+#ifdef _WIN32
+	using Handle = SOCKET;
+	static constexpr Handle invalid = INVALID_SOCKET;
+#else
+	using Handle = int;
+	static constexpr Handle invalid = -1;
+#endif
+
+	Socket() = default;
+
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+
+	Socket(Socket&& other)
+	: handle(other.handle)
+	{
+		other.handle = invalid;
+	}
+
+	Socket& operator=(Socket&& other)
+	{
+		if (this != &other) {
+			Close();
+			handle = other.handle;
+			other.handle = invalid;
+		}
+		return *this;
+	}
+
+	~Socket()
+	{
+		Close();
+	}
+
+	bool Valid() const
+	{
+		return handle != invalid;
+	}
+
+	// listens on port on every interface
+	static Socket Listen(unsigned short port)
+	{
+		Startup();
+		Socket socket(::socket(AF_INET, SOCK_STREAM, 0));
+		if (!socket.Valid()) {
+			throw std::runtime_error("Could not open a socket");
+		}
+		const int on = 1;
+		setsockopt(socket.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+		sockaddr_in address;
+		std::memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_ANY);
+		address.sin_port = htons(port);
+		if (bind(socket.handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+			listen(socket.handle, SOMAXCONN) != 0) {
+			throw std::runtime_error("Could not listen on port " + std::to_string(port));
+		}
+		return socket;
+	}
+
+	Socket Accept() const
+	{
+		Socket socket(accept(handle, nullptr, nullptr));
+		if (!socket.Valid()) {
+			throw std::runtime_error("Could not accept a connection");
+		}
+		socket.Tune();
+		return socket;
+	}
+
+	// an invalid socket if nothing at host:port took the connection
+	static Socket Connect(const std::string& host, unsigned short port)
+	{
+		Startup();
+		addrinfo hints;
+		std::memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo* found = nullptr;
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0) {
+			throw std::runtime_error("Could not look up " + host);
+		}
+		Socket socket;
+		for (addrinfo* at = found; at && !socket.Valid(); at = at->ai_next)
+		{
+			Socket attempt(::socket(at->ai_family, at->ai_socktype, at->ai_protocol));
+			if (attempt.Valid() && connect(attempt.handle, at->ai_addr, static_cast<int>(at->ai_addrlen)) == 0) {
+				socket = std::move(attempt);
+			}
+		}
+		freeaddrinfo(found);
+		if (socket.Valid()) {
+			socket.Tune();
+		}
+		return socket;
+	}
+
+	void SendAll(const void* data, size_t bytes)
+	{
+		const char* at = static_cast<const char*>(data);
+		while (bytes) {
+			const int chunk = static_cast<int>(std::min<size_t>(bytes, 1 << 30));
+			const auto sent = send(handle, at, chunk, flags);
+			if (sent <= 0) {
+				throw std::runtime_error("The connection was lost while sending");
+			}
+			at += sent;
+			bytes -= static_cast<size_t>(sent);
+		}
+	}
+
+	// false if the other end closed the connection before the first byte; closing it
+	// partway through is an error
+	bool ReceiveAll(void* data, size_t bytes)
+	{
+		char* at = static_cast<char*>(data);
+		const size_t wanted = bytes;
+		while (bytes) {
+			const int chunk = static_cast<int>(std::min<size_t>(bytes, 1 << 30));
+			const auto got = recv(handle, at, chunk, 0);
+			if (got == 0 && bytes == wanted) return false;
+			if (got <= 0) {
+				throw std::runtime_error("The connection was lost while receiving");
+			}
+			at += got;
+			bytes -= static_cast<size_t>(got);
+		}
+		return true;
+	}
+
+	// wakes anything blocked receiving on the socket from another thread
+	void Shutdown()
+	{
+		if (!Valid()) return;
+#ifdef _WIN32
+		shutdown(handle, SD_BOTH);
+#else
+		shutdown(handle, SHUT_RDWR);
+#endif
+	}
+
+	// tells the other end nothing more is coming, which it receives as the end of the
+	// connection, while what it still sends can be read
+	void ShutdownSending()
+	{
+		if (!Valid()) return;
+#ifdef _WIN32
+		shutdown(handle, SD_SEND);
+#else
+		shutdown(handle, SHUT_WR);
+#endif
+	}
+
+private:
+	Handle handle = invalid;
+
+#if defined(MSG_NOSIGNAL)
+	// a peer that has gone away is an error to throw, not a signal that ends the process
+	static constexpr int flags = MSG_NOSIGNAL;
+#else
+	static constexpr int flags = 0;
+#endif
+
+	explicit Socket(Handle handle)
+	: handle(handle) {}
+
+	static void Startup()
+	{
+#ifdef _WIN32
+		struct Winsock {
+			Winsock()
+			{
+				WSADATA data;
+				WSAStartup(MAKEWORD(2, 2), &data);
+			}
+
+			~Winsock()
+			{
+				WSACleanup();
+			}
+		};
+		static Winsock winsock;
+#endif
+	}
+
+	// the small messages that end a layer shouldn't sit waiting for more to send with them
+	void Tune()
+	{
+		const int on = 1;
+		setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+#ifdef SO_NOSIGPIPE
+		setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, reinterpret_cast<const char*>(&on), sizeof(on));
+#endif
+	}
+
+	void Close()
+	{
+		if (!Valid()) return;
+#ifdef _WIN32
+		closesocket(handle);
+#else
+		close(handle);
+#endif
+		handle = invalid;
+	}
+};
+
+#endif /* Socket_h */
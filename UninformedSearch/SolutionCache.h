@@ -0,0 +1,379 @@
+#ifndef SolutionCache_h
+#define SolutionCache_h
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Puzzle.h"
+
+// Solutions already found, by start state, so a start that comes up again costs a
+// lookup. Threads share the cache: it is split into shards by key, each with its own
+// lock and its own least recently used list, so lookups of different states rarely
+// wait on one another and the oldest entries make way once a shard is full.
+//
+// A board that is a mirror image of another, with the tiles renamed to match, is solved
+// by the mirror image of that one's path, so long as the mirror leaves the goal where
+// it is. Every such symmetry of the square that keeps the goal's blank in its cell does
+// (for the usual goal, with the blank in the corner, the flip about the diagonal
+// through it), so states are stored in whichever of their images has the lowest key
+// and one entry answers for all of them.
+//
+// Entries are the path and nothing else; a cache holds one strategy's answers towards
+// one goal. Save and Load keep it across runs.
+template <size_t N>
+class SolutionCache {
+public:
+	using Board = Puzzle<N>;
+	using PuzzleState = typename Board::PuzzleState;
+	using MOVE = typename Board::MOVE;
+	using Moves = typename Board::Moves;
+	using Key = uint64_t;
+
+	static constexpr size_t size = PuzzleState::size;
+
+	struct Stats {
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t entries = 0;
+		size_t evictions = 0;
+	};
+
+	// capacity is in entries, spread evenly over the shards
+	SolutionCache(const PuzzleState& goal, size_t capacity, size_t shardCount = 16)
+	: goal(goal), shards(std::max<size_t>(shardCount, 1)), perShard(std::max<size_t>(capacity / shards.size(), 1))
+	{
+		if (!Packed::value) {
+			throw std::logic_error("A solution cache needs a board of 16 cells or fewer");
+		}
+		for (size_t op = 0; op < 8; ++op)
+		{
+			Symmetry symmetry;
+			if (Build(op, symmetry)) {
+				symmetries.push_back(symmetry);
+			}
+		}
+	}
+
+	const PuzzleState& Goal() const
+	{
+		return goal;
+	}
+
+	// the symmetries in use, the identity among them
+	size_t Symmetries() const
+	{
+		return symmetries.size();
+	}
+
+	// fills in path and gives true if state has been solved before
+	bool Find(const PuzzleState& state, Moves& path)
+	{
+		const auto canonical = Canonical(state);
+		Shard& shard = ShardOf(canonical.first);
+		std::lock_guard<std::mutex> guard(shard.lock);
+		auto found = shard.index.find(canonical.first);
+		if (found == shard.index.end()) {
+			++shard.misses;
+			return false;
+		}
+		++shard.hits;
+		// the most recently used go to the front
+		shard.order.splice(shard.order.begin(), shard.order, found->second);
+		path = Transform(found->second->second, symmetries[canonical.second].back);
+		return true;
+	}
+
+	void Insert(const PuzzleState& state, const Moves& path)
+	{
+		const auto canonical = Canonical(state);
+		Store(canonical.first, Transform(path, symmetries[canonical.second].move));
+	}
+
+	Stats Counters() const
+	{
+		Stats stats;
+		for (auto& shard : shards)
+		{
+			std::lock_guard<std::mutex> guard(shard.lock);
+			stats.hits += shard.hits;
+			stats.misses += shard.misses;
+			stats.entries += shard.order.size();
+			stats.evictions += shard.evictions;
+		}
+		return stats;
+	}
+
+	// Writes every entry to path, least recently used first so loading them again in
+	// order keeps the order.
+	void Save(const std::string& path) const
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			throw std::runtime_error("Could not create " + path);
+		}
+		FileHeader header = {};
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.n = N;
+		for (size_t i = 0; i < size; ++i)
+		{
+			header.goal[i] = static_cast<unsigned char>(goal.Get(i));
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (auto& shard : shards)
+		{
+			std::lock_guard<std::mutex> guard(shard.lock);
+			for (auto entry = shard.order.rbegin(); entry != shard.order.rend(); ++entry)
+			{
+				Write(out, entry->first, entry->second);
+			}
+		}
+		if (!out.flush()) {
+			throw std::runtime_error("Could not write " + path);
+		}
+	}
+
+	// Reads back what Save wrote, giving the entries read. A file that isn't there is
+	// an empty cache; one for another size of board or another goal is an error.
+	size_t Load(const std::string& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		if (!in) return 0;
+		FileHeader header;
+		if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.n != N) {
+			throw std::runtime_error(path + " is not a solution cache for this size of puzzle");
+		}
+		for (size_t i = 0; i < size; ++i)
+		{
+			if (header.goal[i] != static_cast<unsigned char>(goal.Get(i))) {
+				throw std::runtime_error(path + " was saved for a different goal");
+			}
+		}
+		size_t count = 0;
+		Key key;
+		Moves moves;
+		while (Read(in, key, moves)) {
+			Store(key, moves);
+			++count;
+		}
+		return count;
+	}
+
+private:
+	using Packed = std::integral_constant<bool, (size <= 16)>;
+	using Order = std::list<std::pair<Key, Moves>>;
+
+	// on disk layout; integers are stored in the byte order of the machine that saved it
+	static constexpr char magic[8] = { 'P', 'U', 'Z', 'S', 'C', 'H', '0', '1' };
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t n;
+		unsigned char goal[32];
+	};
+
+	// One of the eight symmetries of the square: where each cell goes, what each tile is
+	// renamed to and what each move becomes, and back again for the moves.
+	struct Symmetry {
+		unsigned char cell[size];
+		unsigned char tile[size];
+		MOVE move[5];
+		MOVE back[5];
+	};
+
+	struct Shard {
+		mutable std::mutex lock;
+		Order order;
+		std::unordered_map<Key, typename Order::iterator> index;
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t evictions = 0;
+	};
+
+	const PuzzleState goal;
+	std::vector<Symmetry> symmetries;
+	// mutexes don't move so the shards are made once, all together
+	std::vector<Shard> shards;
+	const size_t perShard;
+
+	// the eight ways to map row r and column c of a board whose last index is last; with
+	// last 0 this is what each does to a direction
+	static void Map(size_t op, int last, int r, int c, int& row, int& col)
+	{
+		switch (op) {
+			case 0: row = r; col = c; break;
+			case 1: row = c; col = r; break;
+			case 2: row = last - c; col = last - r; break;
+			case 3: row = last - r; col = last - c; break;
+			case 4: row = last - r; col = c; break;
+			case 5: row = r; col = last - c; break;
+			case 6: row = c; col = last - r; break;
+			default: row = last - c; col = r; break;
+		}
+	}
+
+	// false if op moves the goal's blank, and so the goal
+	bool Build(size_t op, Symmetry& symmetry) const
+	{
+		const int last = int(N) - 1;
+		for (size_t i = 0; i < size; ++i)
+		{
+			int row, col;
+			Map(op, last, int(i / N), int(i % N), row, col);
+			symmetry.cell[i] = static_cast<unsigned char>(row * N + col);
+		}
+		if (symmetry.cell[goal.Blank()] != goal.Blank()) return false;
+		// a tile is renamed to the one whose home its own home is mapped to
+		for (size_t i = 0; i < size; ++i)
+		{
+			symmetry.tile[static_cast<size_t>(goal.Get(i))] = static_cast<unsigned char>(goal.Get(symmetry.cell[i]));
+		}
+		// the directions of the blank's moves, as MoveTable makes them
+		static const int rows[5] = { 0, -1, 1, 0, 0 }, cols[5] = { 0, 0, 0, -1, 1 };
+		symmetry.move[0] = symmetry.back[0] = Board::NONE;
+		for (unsigned m = Board::UP; m <= Board::RIGHT; ++m)
+		{
+			int row, col;
+			Map(op, 0, rows[m], cols[m], row, col);
+			for (unsigned to = Board::UP; to <= Board::RIGHT; ++to)
+			{
+				if (rows[to] == row && cols[to] == col) {
+					symmetry.move[m] = static_cast<MOVE>(to);
+					symmetry.back[to] = static_cast<MOVE>(m);
+				}
+			}
+		}
+		return true;
+	}
+
+	static PuzzleState Apply(const PuzzleState& state, const Symmetry& symmetry)
+	{
+		PuzzleState image;
+		for (size_t i = 0; i < size; ++i)
+		{
+			image.Set(symmetry.cell[i], static_cast<char>(symmetry.tile[static_cast<size_t>(state.Get(i))]));
+		}
+		return image;
+	}
+
+	static Moves Transform(const Moves& path, const MOVE (&map)[5])
+	{
+		Moves moves;
+		moves.reserve(path.size());
+		for (auto m : path)
+		{
+			moves.push_back(map[m]);
+		}
+		return moves;
+	}
+
+	// the lowest key among the images of state, and which symmetry gives it
+	std::pair<Key, size_t> Canonical(const PuzzleState& state) const
+	{
+		std::pair<Key, size_t> best(Pack(state, Packed()), 0);
+		for (size_t s = 1; s < symmetries.size(); ++s)
+		{
+			const Key key = Pack(Apply(state, symmetries[s]), Packed());
+			if (key < best.first) {
+				best = { key, s };
+			}
+		}
+		return best;
+	}
+
+	static Key Pack(const PuzzleState& state, std::true_type)
+	{
+		return state.Key();
+	}
+
+	// larger boards never get a cache
+	static Key Pack(const PuzzleState&, std::false_type)
+	{
+		return 0;
+	}
+
+	Shard& ShardOf(Key key)
+	{
+		// the board's own bits are not spread well so they are mixed first
+		return shards[(key * 0x9E3779B97F4A7C15ull >> 32) % shards.size()];
+	}
+
+	void Store(Key key, Moves path)
+	{
+		Shard& shard = ShardOf(key);
+		std::lock_guard<std::mutex> guard(shard.lock);
+		auto found = shard.index.find(key);
+		if (found != shard.index.end()) {
+			found->second->second = std::move(path);
+			shard.order.splice(shard.order.begin(), shard.order, found->second);
+			return;
+		}
+		if (shard.order.size() == perShard) {
+			shard.index.erase(shard.order.back().first);
+			shard.order.pop_back();
+			++shard.evictions;
+		}
+		shard.order.emplace_front(key, std::move(path));
+		shard.index[key] = shard.order.begin();
+	}
+
+	// a key, the number of moves and then the moves four to a byte
+	static void Write(std::ostream& out, Key key, const Moves& moves)
+	{
+		const uint32_t length = static_cast<uint32_t>(moves.size());
+		std::vector<unsigned char> bytes((length + 3) / 4, 0);
+		for (size_t i = 0; i < length; ++i)
+		{
+			bytes[i / 4] |= static_cast<unsigned char>((moves[i] - Board::UP) << ((i % 4) * 2));
+		}
+		out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+		out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+		out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	}
+
+	// false at the end of the file; one that ends partway through an entry is an error
+	static bool Read(std::istream& in, Key& key, Moves& moves)
+	{
+		uint32_t length;
+		if (!in.read(reinterpret_cast<char*>(&key), sizeof(key))) {
+			if (in.gcount()) {
+				throw std::runtime_error("The solution cache is truncated");
+			}
+			return false;
+		}
+		std::vector<unsigned char> bytes;
+		if (in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+			// no path comes anywhere near this, so the file has to be corrupt
+			if (length > (1u << 16)) {
+				throw std::runtime_error("The solution cache is corrupt");
+			}
+			bytes.resize((length + 3) / 4);
+			in.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+		}
+		if (!in) {
+			throw std::runtime_error("The solution cache is truncated");
+		}
+		moves.clear();
+		moves.reserve(length);
+		for (size_t i = 0; i < length; ++i)
+		{
+			moves.push_back(static_cast<MOVE>(Board::UP + ((bytes[i / 4] >> ((i % 4) * 2)) & 3)));
+		}
+		return true;
+	}
+};
+
+template <size_t N>
+constexpr char SolutionCache<N>::magic[8];
+
+#endif /* SolutionCache_h */
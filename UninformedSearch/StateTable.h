@@ -0,0 +1,328 @@
+#ifndef StateTable_h
+#define StateTable_h
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+#include "PageMemory.h"
+
+// Asks for the cache line holding address ahead of a lookup there. It's only a hint:
+// where there is no way to give it, nothing happens.
+inline void PrefetchLine(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+	(void)address;
+#endif
+}
+
+// murmur3's 64 bit finalizer: every bit of h has a part in every bit of the result, so
+// the low bits a table indexes with are as good as the high ones. The boards' hash and
+// every table here keyed by a packed board mix with it.
+inline uint64_t Mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+// Permutation ranking after Myrvold & Ruskey, "Ranking and unranking permutations in
+// linear time". Every arrangement of a board's tiles maps onto a unique integer in
+// [0, size!) so a board that small can index a flat table directly.
+template <class State>
+struct PermutationRank {
+	static constexpr size_t size = State::size;
+
+	static constexpr uint64_t Count(size_t n = size)
+	{
+		return (n <= 1) ? 1 : n * Count(n - 1);
+	}
+
+	static uint64_t Rank(const State& state)
+	{
+		unsigned char perm[size], inverse[size];
+		for (size_t i = 0; i < size; ++i)
+		{
+			perm[i] = static_cast<unsigned char>(state.Get(i));
+			inverse[perm[i]] = static_cast<unsigned char>(i);
+		}
+
+		uint64_t rank = 0, radix = 1;
+		for (size_t n = size; n > 1; --n)
+		{
+			const auto s = perm[n - 1];
+			std::swap(perm[n - 1], perm[inverse[n - 1]]);
+			std::swap(inverse[s], inverse[n - 1]);
+			rank += s * radix;
+			radix *= n;
+		}
+		return rank;
+	}
+
+	static State Unrank(uint64_t rank)
+	{
+		unsigned char perm[size];
+		for (size_t i = 0; i < size; ++i)
+		{
+			perm[i] = static_cast<unsigned char>(i);
+		}
+		for (size_t n = size; n > 1; --n)
+		{
+			std::swap(perm[n - 1], perm[rank % n]);
+			rank /= n;
+		}
+
+		State state;
+		for (size_t i = 0; i < size; ++i)
+		{
+			state.Set(i, perm[i]);
+		}
+		return state;
+	}
+};
+
+// A table with a slot for every permutation of the board. Lookups are a rank and an
+// index--no hashing, no probing and no collisions.
+//
+// Filling all size! slots would cost more than a whole search of an easy board, so the
+// slots outlive the table: each thread keeps the ones its last tables gave back, and a
+// new table takes them over with a fresh stamp. A slot only holds a value for the table
+// whose stamp it carries, so what earlier searches left there reads as empty.
+//
+// Both tables can be looked up in two steps as well as one: Address works out where a
+// state lives, Prefetch asks for that memory, and Find and Insert given the address go
+// there without working it out again. A search that has many states to look up at once
+// can then wait on all their cache misses together.
+template <class State, class Value>
+class RankedStateTable {
+public:
+	using Rank = PermutationRank<State>;
+
+	explicit RankedStateTable(size_t /*expected*/ = 0, Value empty = Value())
+	: storage(Take()), empty(empty)
+	{
+		if (++storage->stamp == 0) {
+			// every stamp has been used, so those left are cleared before starting again
+			for (auto& slot : storage->slots)
+			{
+				slot.stamp = 0;
+			}
+			storage->stamp = 1;
+		}
+		stamp = storage->stamp;
+	}
+
+	RankedStateTable(const RankedStateTable&) = delete;
+	RankedStateTable& operator=(const RankedStateTable&) = delete;
+
+	~RankedStateTable()
+	{
+		// as many as a search has at once (see Puzzle::SolveBiDirectional)
+		auto& spare = Spare();
+		if (spare.size() < 2) {
+			spare.push_back(std::move(storage));
+		}
+	}
+
+	size_t Address(const State& state) const
+	{
+		return static_cast<size_t>(Rank::Rank(state));
+	}
+
+	void Prefetch(size_t address) const
+	{
+		PrefetchLine(&storage->slots[address]);
+	}
+
+	Value* Find(const State& state)
+	{
+		return Find(state, Address(state));
+	}
+
+	Value* Find(const State&, size_t address)
+	{
+		auto& slot = storage->slots[address];
+		return (slot.stamp != stamp || slot.value == empty) ? nullptr : &slot.value;
+	}
+
+	// inserts or replaces the value stored for state
+	void Insert(const State& state, Value value)
+	{
+		Insert(state, value, Address(state));
+	}
+
+	void Insert(const State&, Value value, size_t address)
+	{
+		auto& slot = storage->slots[address];
+		count += (slot.stamp != stamp || slot.value == empty);
+		slot = Slot{value, stamp};
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	size_t bytes() const
+	{
+		return storage->slots.capacity() * sizeof(Slot);
+	}
+
+private:
+	struct Slot {
+		Value value;
+		uint32_t stamp;
+	};
+
+	struct Storage {
+		std::vector<Slot, PageAllocator<Slot>> slots;
+		uint32_t stamp = 0;
+	};
+
+	std::unique_ptr<Storage> storage;
+	const Value empty;
+	uint32_t stamp = 0;
+	size_t count = 0;
+
+	static std::vector<std::unique_ptr<Storage>>& Spare()
+	{
+		static thread_local std::vector<std::unique_ptr<Storage>> spare;
+		return spare;
+	}
+
+	static std::unique_ptr<Storage> Take()
+	{
+		auto& spare = Spare();
+		if (spare.empty()) {
+			std::unique_ptr<Storage> storage(new Storage);
+			storage->slots.resize(static_cast<size_t>(Rank::Count()), Slot{Value(), 0});
+			return storage;
+		}
+		std::unique_ptr<Storage> storage = std::move(spare.back());
+		spare.pop_back();
+		return storage;
+	}
+};
+
+// Open addressing with linear probing for boards whose permutations are too many
+// to enumerate. The table starts large enough for the expected search and doubles
+// before it passes half full, so probe runs stay short.
+template <class State, class Value>
+class HashedStateTable {
+public:
+	explicit HashedStateTable(size_t expected = 1 << 16, Value empty = Value())
+	: empty(empty)
+	{
+		size_t capacity = 16;
+		while (capacity < expected * 2) {
+			capacity <<= 1;
+		}
+		slots.resize(capacity, Slot{State(), empty});
+		mask = capacity - 1;
+	}
+
+	// the state's hash, which stays good as the table grows
+	size_t Address(const State& state) const
+	{
+		return state.hash();
+	}
+
+	void Prefetch(size_t address) const
+	{
+		PrefetchLine(&slots[address & mask]);
+	}
+
+	Value* Find(const State& state)
+	{
+		return Find(state, Address(state));
+	}
+
+	Value* Find(const State& state, size_t address)
+	{
+		auto& slot = Probe(state, address);
+		return (slot.value == empty) ? nullptr : &slot.value;
+	}
+
+	void Insert(const State& state, Value value)
+	{
+		Insert(state, value, Address(state));
+	}
+
+	void Insert(const State& state, Value value, size_t address)
+	{
+		auto* slot = &Probe(state, address);
+		if (slot->value == empty) {
+			if ((count + 1) * 2 > slots.size()) {
+				Grow();
+				slot = &Probe(state, address);
+			}
+			++count;
+			slot->key = state;
+		}
+		slot->value = value;
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	size_t bytes() const
+	{
+		return slots.capacity() * sizeof(Slot);
+	}
+
+private:
+	struct Slot {
+		State key;
+		Value value;
+	};
+	using Slots = std::vector<Slot, PageAllocator<Slot>>;
+
+	Slots slots;
+	const Value empty;
+	size_t mask = 0;
+	size_t count = 0;
+
+	Slot& Probe(const State& state, size_t hash)
+	{
+		size_t i = hash & mask;
+		while (!(slots[i].value == empty) && !(slots[i].key == state)) {
+			i = (i + 1) & mask;
+		}
+		return slots[i];
+	}
+
+	void Grow()
+	{
+		Slots old(slots.size() * 2, Slot{State(), empty});
+		old.swap(slots);
+		mask = slots.size() - 1;
+		for (auto& slot : old)
+		{
+			if (!(slot.value == empty)) {
+				Probe(slot.key, slot.key.hash()) = slot;
+			}
+		}
+	}
+};
+
+// the 8-puzzle and smaller fit in a rank indexed table (9! slots), anything bigger is hashed
+template <class State, class Value>
+using StateTable = typename std::conditional<(State::size <= 9),
+	RankedStateTable<State, Value>, HashedStateTable<State, Value>>::type;
+
+#endif /* StateTable_h */
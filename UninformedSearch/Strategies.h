@@ -0,0 +1,163 @@
+#ifndef Strategies_h
+#define Strategies_h
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Heuristics.h"
+#include "PatternDatabase.h"
+#include "Puzzle.h"
+
+// the usual goal: tiles in order with the blank in the bottom right corner
+template <size_t N>
+typename Puzzle<N>::PuzzleState OrderedGoal()
+{
+	typename Puzzle<N>::PuzzleState goal;
+	for (size_t i = 0; i < goal.size; ++i)
+	{
+		goal.Set(i, static_cast<char>((i + 1) % goal.size));
+	}
+	return goal;
+}
+
+using StrategyFactory = std::function<std::shared_ptr<PuzzleStrategy>()>;
+
+// strategies are made fresh for every search since they carry the frontier
+template <class Strategy, class... Args>
+StrategyFactory Make(Args... args)
+{
+	return [=] { return std::make_shared<Strategy>(args...); };
+}
+
+// the same strategies, each given budget to keep to
+inline StrategyFactory Limited(StrategyFactory factory, const SearchBudget& budget)
+{
+	return [factory, budget] {
+		auto strategy = factory();
+		strategy->SetBudget(budget);
+		return strategy;
+	};
+}
+
+// room for about a million states; with 16 bytes for each that is plenty for an 8puzzle
+// and makes a dent in the 15puzzle's transpositions without a long setup per search
+constexpr size_t defaultTableMegabytes = 16;
+
+// A strategy, its name, its costs and whether the path it finds is always a shortest
+// one, so it can be kept as the answer (see BatchSolver::SetCache)
+template <size_t N>
+using StrategyTable = std::vector<std::tuple<StrategyFactory,std::string,typename Puzzle<N>::CostCalc,typename Puzzle<N>::CostUpdate,bool>>;
+
+// Walking distance keeps its counts in a word, which only boards of up to 4x4 fit; the
+// rows that use it are left out for anything larger
+template <size_t N>
+std::pair<typename Puzzle<N>::CostCalc, typename Puzzle<N>::CostUpdate> WalkingDistanceCosts(const typename Puzzle<N>::PuzzleState& goal, std::true_type)
+{
+	const WalkingDistance<N> walking(goal);
+	return { walking, IncrementalCost(walking) };
+}
+
+template <size_t N>
+std::pair<typename Puzzle<N>::CostCalc, typename Puzzle<N>::CostUpdate> WalkingDistanceCosts(const typename Puzzle<N>::PuzzleState&, std::false_type)
+{
+	return {};
+}
+
+// the most moves any board of the size can need, as far as anyone has shown
+constexpr size_t LongestSolution(size_t n)
+{
+	// 6 for the 3puzzle, 31 for the 8puzzle and 80 for the 15puzzle are exact. The 24
+	// puzzle's isn't known, so it gets a proven upper bound.
+	return (n == 2) ? 6 : (n == 3) ? 31 : (n == 4) ? 80 : 208;
+}
+
+// Every strategy the program knows, by name. Search.cpp runs them all on a puzzle and
+// the benchmark times them. pdb is optional; when present it is searched with
+// alongside the other heuristics. table is the megabytes of transposition table the
+// depth first searches that keep one are given. Boards too big to pack into a word
+// can't have a layered search or a transposition table, so those rows are left out.
+template <size_t N>
+StrategyTable<N> Strategies(const typename Puzzle<N>::PuzzleState& goal, const PatternDatabase<N>* pdb,
+							size_t table = defaultTableMegabytes)
+{
+	using Board = Puzzle<N>;
+	using PuzzleState = typename Board::PuzzleState;
+	typename Board::CostCalc defaultValue;
+	typename Board::CostUpdate fromScratch;
+
+	// no search needs to look further than the longest solution there is
+	const size_t longest = LongestSolution(N);
+	const bool packed = PuzzleState::size <= 16;
+
+	// the tables are built once here and shared by every search below
+	const ManhattanDistance<N> manhattan(goal);
+	const MisplacedTiles<N> misplaced(goal);
+	const LinearConflict<N> linear(goal);
+	const auto walking = WalkingDistanceCosts<N>(goal, std::integral_constant<bool, (N <= 4)>());
+
+	typename Board::CostCalc manhattanInversions = [manhattan](const PuzzleState& state, const PuzzleState& goal, int cumulativeCost) {
+		return manhattan(state, goal, cumulativeCost) + state.Inversions(goal)/2;
+	};
+	typename Board::CostCalc manhattanGreedy = [manhattan](const PuzzleState& state, const PuzzleState& goal, int) {
+		// greedy doesnt care about the cost to arrive at this point
+		return manhattan(state, goal, 0);
+	};
+
+	using std::make_tuple;
+	StrategyTable<N> strategies;
+	strategies.push_back(make_tuple( Make<BreadthFirstSearch>(), "BreadthFirstSearch", defaultValue, fromScratch, true));
+	if (packed) {
+		// keeps three layers of packed states rather than every node it has made
+		strategies.push_back(make_tuple( Make<FrontierBreadthFirstSearch>(), "FrontierBreadthFirstSearch", defaultValue, fromScratch, true));
+	}
+	strategies.push_back(make_tuple( Make<DepthFirstSearch>(), "DepthFirstSearch", defaultValue, fromScratch, false));
+	strategies.push_back(make_tuple( Make<DepthLimitedSearch>(longest), "DepthLimitedSearch", defaultValue, fromScratch, false));
+	if (packed) {
+		// a fixed size transposition table in place of the explored set
+		strategies.push_back(make_tuple( Make<DepthLimitedSearch>(longest, table), "DepthLimitedSearchTable", defaultValue, fromScratch, false));
+	}
+	strategies.push_back(make_tuple( Make<IterativeDeepeningSearch>(1, longest), "IterativeDeepeningSearch", defaultValue, fromScratch, true));
+	// with a heuristic the bound is on estimated cost rather than depth (IDA*)
+	strategies.push_back(make_tuple( Make<IterativeDeepeningSearch>(0, longest), "IterativeDeepeningManhattanDistance", manhattan, IncrementalCost(manhattan), true));
+	if (packed) {
+		// and remembering what it can of each iteration to cut off transpositions in the next
+		strategies.push_back(make_tuple( Make<IterativeDeepeningSearch>(0, longest, table), "IterativeDeepeningManhattanDistanceTable", manhattan, IncrementalCost(manhattan), true));
+	}
+	strategies.push_back(make_tuple( Make<IterativeDeepeningSearch>(0, longest), "IterativeDeepeningLinearConflict", linear, IncrementalCost(linear), true));
+	if (walking.first) {
+		strategies.push_back(make_tuple( Make<IterativeDeepeningSearch>(0, longest), "IterativeDeepeningWalkingDistance", walking.first, walking.second, true));
+	}
+	strategies.push_back(make_tuple( Make<BiDirectionalSearch>(), "BiDirectionalSearch", defaultValue, fromScratch, true));
+	// meets in the middle with the heuristic guiding both sides (MM)
+	strategies.push_back(make_tuple( Make<BiDirectionalSearch>(true), "BiDirectionalManhattanDistance", manhattan, IncrementalCost(manhattan), true));
+	strategies.push_back(make_tuple( Make<QueueStrategy>(), "ManhattanDistance", manhattan, IncrementalCost(manhattan), true));
+	strategies.push_back(make_tuple( Make<HashDistributedSearch>(), "HashDistributedManhattanDistance", manhattan, IncrementalCost(manhattan), true));
+	// stronger than Manhattan distance but still admissible, so still the shortest path
+	strategies.push_back(make_tuple( Make<QueueStrategy>(), "ManhattanDistanceLinearConflict", linear, IncrementalCost(linear), true));
+	if (walking.first) {
+		strategies.push_back(make_tuple( Make<QueueStrategy>(), "WalkingDistance", walking.first, walking.second, true));
+	}
+	// inversions can't be updated incrementally so this one is scored from scratch. Half
+	// the inversions can overestimate, so unlike the rest the path may not be the shortest
+	strategies.push_back(make_tuple( Make<QueueStrategy>(), "ManhattanDistanceInversions", manhattanInversions, fromScratch, false));
+	strategies.push_back(make_tuple( Make<QueueStrategy>(), "ManhattanDistanceGreedy", manhattanGreedy, IncrementalCost(manhattan, 0), false));
+	// nearly as quick as greedy, but with the path at most twice the shortest
+	strategies.push_back(make_tuple( Make<WeightedSearch>(2.0), "WeightedManhattanDistance", manhattan, IncrementalCost(manhattan), false));
+	strategies.push_back(make_tuple( Make<WeightedSearch>(2.0), "WeightedLinearConflict", linear, IncrementalCost(linear), false));
+	// ARA* from three times down to the shortest, with a better path at every step
+	strategies.push_back(make_tuple( Make<AnytimeSearch>(3.0, 0.5), "AnytimeManhattanDistance", manhattan, IncrementalCost(manhattan), true));
+	strategies.push_back(make_tuple( Make<AnytimeSearch>(3.0, 0.5), "AnytimeLinearConflict", linear, IncrementalCost(linear), true));
+	strategies.push_back(make_tuple( Make<QueueStrategy>(), "MisplacedTiles", misplaced, IncrementalCost(misplaced), true));
+	if (pdb && pdb->Goal() == goal) {
+		strategies.push_back(make_tuple( Make<QueueStrategy>(), "PatternDatabase", *pdb, IncrementalCost(*pdb), true));
+		strategies.push_back(make_tuple( Make<IterativeDeepeningSearch>(0, longest), "IterativeDeepeningPatternDatabase", *pdb, IncrementalCost(*pdb), true));
+	}
+	return strategies;
+}
+
+#endif /* Strategies_h */
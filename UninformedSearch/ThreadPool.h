@@ -0,0 +1,144 @@
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of workers, each with its own deque of tasks. Workers take from the
+// back of their own deque and, when it runs dry, steal from the front of the
+// others', so a few long tasks on one worker don't leave the rest idle.
+class ThreadPool {
+public:
+	using Task = std::function<void()>;
+
+	explicit ThreadPool(size_t threads = std::thread::hardware_concurrency())
+	{
+		threads = std::max<size_t>(threads, 1);
+		for (size_t i = 0; i < threads; ++i)
+		{
+			queues.emplace_back(new Queue);
+		}
+		for (size_t i = 0; i < threads; ++i)
+		{
+			workers.emplace_back([this, i] { Run(i); });
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// finishes everything already submitted before the workers exit
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> guard(sleep);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void Submit(Task task)
+	{
+		auto& queue = *queues[next++ % queues.size()];
+		{
+			std::lock_guard<std::mutex> guard(queue.lock);
+			queue.tasks.push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> guard(sleep);
+			++pending;
+			++queued;
+		}
+		wake.notify_one();
+	}
+
+	// blocks until every submitted task has finished
+	void Wait()
+	{
+		std::unique_lock<std::mutex> guard(sleep);
+		idle.wait(guard, [this] { return pending == 0; });
+	}
+
+	size_t Size() const
+	{
+		return workers.size();
+	}
+
+private:
+	struct Queue {
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<size_t> next{0};
+
+	// guards the counters below and pairs with both condition variables
+	std::mutex sleep;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	size_t pending = 0; // submitted but not finished
+	size_t queued = 0;  // submitted but not started
+	bool stopping = false;
+
+	bool Take(size_t self, Task& task)
+	{
+		for (size_t i = 0; i < queues.size(); ++i)
+		{
+			auto& queue = *queues[(self + i) % queues.size()];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if (queue.tasks.empty()) continue;
+
+			// our own work is hottest at the back, stolen work is oldest at the front
+			if (i == 0) {
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			} else {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void Run(size_t self)
+	{
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> guard(sleep);
+				wake.wait(guard, [this] { return stopping || queued > 0; });
+				if (queued == 0) {
+					return; // stopping and nothing left to do
+				}
+				--queued;
+			}
+
+			// a task is reserved for us so one of the queues is guaranteed to have it
+			Task task;
+			while (!Take(self, task)) {
+				std::this_thread::yield();
+			}
+			task();
+
+			std::lock_guard<std::mutex> guard(sleep);
+			if (--pending == 0) {
+				idle.notify_all();
+			}
+		}
+	}
+};
+
+#endif /* ThreadPool_h */
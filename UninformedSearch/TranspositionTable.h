@@ -0,0 +1,171 @@
+#ifndef TranspositionTable_h
+#define TranspositionTable_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#include "PageMemory.h"
+#include "StateTable.h"
+
+// A fixed size record of where a depth first search has already been, so IDA* and depth
+// limited search can cut off a state they reach again by another route (a transposition).
+// Each entry is a board packed into a word, the cheapest cost it has been reached at (g)
+// and the bound it was searched under. Reaching it again costing more, or costing the same
+// under a bound no higher, can't find anything new: a cheaper arrival is searched as far
+// as this one and then some, and an equal one searched everything below it already.
+//
+// The table is a power of two of 64 byte buckets, one cache line each, holding four
+// entries. A state only ever lives in its own bucket so a lookup touches one line. When
+// a bucket is full the entry with the least bound left over its g (and so the smallest
+// subtree behind it) makes way, which ages out earlier iterations on its own since their
+// bounds were lower. Entries are forgotten, never wrong, so a smaller table only costs
+// nodes: memory is traded for node count and nothing else.
+//
+// Nothing is locked. An entry is two words, the data and the key xored with the data,
+// written and read separately; a read that races a write sees words that don't match
+// the key and is treated as a miss (Hyatt and Mann's lockless hashing), so threads can
+// share a table without tearing entries.
+class TranspositionTable {
+public:
+	using Key = uint64_t;
+
+	// megabytes is rounded down to a power of two buckets, with at least one
+	explicit TranspositionTable(size_t megabytes)
+	{
+		const size_t budget = (megabytes << 20) / sizeof(Bucket);
+		buckets = 1;
+		while (buckets * 2 <= budget) {
+			buckets *= 2;
+		}
+		// Zeroed memory is an empty table. Pages mapped from the system come already
+		// zero, so only the pages a search reaches are ever touched and a big table
+		// costs nothing to set up. A table of 2MB or more is a whole number of huge
+		// pages, so it gets them when they are configured, and the lines are aligned.
+		storage = std::unique_ptr<void, Unmap>(PageMemory::Map(bytes()), Unmap{ bytes() });
+		table = static_cast<Bucket*>(storage.get());
+		for (size_t i = 0; i < buckets; ++i)
+		{
+			// the atomics are trivially constructed so this leaves the zeros alone
+			new (&table[i]) Bucket;
+		}
+	}
+
+	TranspositionTable(const TranspositionTable&) = delete;
+	TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+	// True if state has been searched in a way that covers reaching it at g under bound;
+	// otherwise it is recorded as searched that way and false comes back.
+	bool Visit(Key state, size_t g, size_t bound)
+	{
+		Bucket& bucket = table[Mix(state) & (buckets - 1)];
+		const uint64_t data = Pack(g, bound);
+		Slot* victim = nullptr;
+		size_t least = size_t(-1);
+		for (Slot& slot : bucket.slots)
+		{
+			const uint64_t stored = slot.data.load(std::memory_order_relaxed);
+			const uint64_t check = slot.check.load(std::memory_order_relaxed);
+			if (stored && (check ^ stored) == state) {
+				const size_t seenG = G(stored), seenBound = Bound(stored);
+				if (seenG < g || (seenG == g && seenBound >= bound)) {
+					++hits;
+					return true;
+				}
+				// the same state, now cheaper or searched deeper, replaces itself
+				victim = &slot;
+				break;
+			}
+			const size_t left = (stored) ? Left(stored) : 0;
+			if (!stored || left < least) {
+				victim = &slot;
+				least = (stored) ? left : 0;
+				if (!stored) break;
+			}
+		}
+		if (!victim->data.load(std::memory_order_relaxed)) {
+			++used;
+		}
+		victim->data.store(data, std::memory_order_relaxed);
+		victim->check.store(state ^ data, std::memory_order_relaxed);
+		return false;
+	}
+
+	// lookups that cut off a search
+	size_t Hits() const
+	{
+		return hits;
+	}
+
+	// entries holding a state
+	size_t size() const
+	{
+		return used;
+	}
+
+	size_t capacity() const
+	{
+		return buckets * ways;
+	}
+
+	size_t bytes() const
+	{
+		return buckets * sizeof(Bucket);
+	}
+
+private:
+	static constexpr size_t line = 64;
+	static constexpr size_t ways = 4;
+
+	struct Slot {
+		std::atomic<uint64_t> check;
+		std::atomic<uint64_t> data;
+	};
+
+	struct Bucket {
+		Slot slots[ways];
+	};
+
+	static_assert(sizeof(Bucket) == line, "a bucket is one cache line");
+
+	struct Unmap {
+		size_t bytes;
+
+		void operator()(void* p) const
+		{
+			PageMemory::Unmap(p, bytes);
+		}
+	};
+
+	std::unique_ptr<void, Unmap> storage;
+	Bucket* table = nullptr;
+	size_t buckets = 0;
+	// statistics only, so a thread sharing the table may lose a count
+	size_t hits = 0;
+	size_t used = 0;
+
+	// g and bound in the low and high halves with the top bit set so data is never 0
+	static uint64_t Pack(size_t g, size_t bound)
+	{
+		return (uint64_t(1) << 63) | (uint64_t(bound & 0x7FFFFFFF) << 32) | uint64_t(g & 0xFFFFFFFF);
+	}
+
+	static size_t G(uint64_t data)
+	{
+		return size_t(data & 0xFFFFFFFF);
+	}
+
+	static size_t Bound(uint64_t data)
+	{
+		return size_t((data >> 32) & 0x7FFFFFFF);
+	}
+
+	static size_t Left(uint64_t data)
+	{
+		return (Bound(data) > G(data)) ? Bound(data) - G(data) : 0;
+	}
+};
+
+#endif /* TranspositionTable_h */